@@ -1,4 +1,5 @@
 #include "AESWrapper.h"
+#include "Tracer.h"
 
 #include <cryptopp/modes.h>
 #include <cryptopp/aes.h>
@@ -15,12 +16,12 @@ unsigned char* AESWrapper::GenerateKey(unsigned char* buffer, unsigned int lengt
 	return buffer;
 }
 
-AESWrapper::AESWrapper()
+AESWrapper::AESWrapper() : _decryptionKeyed(false)
 {
 	GenerateKey(_key, DEFAULT_KEYLENGTH);
 }
 
-AESWrapper::AESWrapper(const unsigned char* key, unsigned int length)
+AESWrapper::AESWrapper(const unsigned char* key, unsigned int length) : _decryptionKeyed(false)
 {
 	if (length != DEFAULT_KEYLENGTH)
 		throw std::length_error("key length must be 16 bytes");
@@ -38,6 +39,7 @@ const unsigned char* AESWrapper::getKey() const
 
 std::string AESWrapper::encrypt(const char* plain, unsigned int length)
 {
+	TRACE_SCOPE("aes.encrypt");
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
 
 	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
@@ -54,6 +56,7 @@ std::string AESWrapper::encrypt(const char* plain, unsigned int length)
 
 std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 {
+	TRACE_SCOPE("aes.decrypt");
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
 
 	CryptoPP::AES::Decryption aesDecryption(_key, DEFAULT_KEYLENGTH);
@@ -66,3 +69,32 @@ std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 
 	return decrypted;
 }
+
+size_t AESWrapper::decrypt(const char* cipher, unsigned int length, char* plain)
+{
+	TRACE_SCOPE("aes.decrypt");
+	if (length == 0 || length % CryptoPP::AES::BLOCKSIZE != 0)
+		throw std::length_error("cipher length must be a non-zero multiple of the block size");
+
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// same fixed iv as the filter based overload
+	// the key schedule is only built when needed, so encrypt-only wrappers never pay for it
+	if (_decryptionKeyed) {
+		_decryption.Resynchronize(iv);
+	}
+	else {
+		_decryption.SetKeyWithIV(_key, DEFAULT_KEYLENGTH, iv);
+		_decryptionKeyed = true;
+	}
+	_decryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(plain), reinterpret_cast<const CryptoPP::byte*>(cipher), length);
+
+	// strip PKCS#7 padding, which StreamTransformationFilter would otherwise remove for us
+	unsigned char padding = static_cast<unsigned char>(plain[length - 1]);
+	if (padding == 0 || padding > CryptoPP::AES::BLOCKSIZE)
+		throw std::runtime_error("invalid padding");
+	for (unsigned int i = length - padding; i < length; i++) {
+		if (static_cast<unsigned char>(plain[i]) != padding)
+			throw std::runtime_error("invalid padding");
+	}
+
+	return length - padding;
+}
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <string>
-
+#include <cryptopp/modes.h>
+#include <cryptopp/aes.h>
 
 class AESWrapper
 {
@@ -9,6 +10,8 @@ public:
 	static const unsigned int DEFAULT_KEYLENGTH = 16;
 private:
 	unsigned char _key[DEFAULT_KEYLENGTH];
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption _decryption;	// keyed on the first buffer decrypt
+	bool _decryptionKeyed;
 	AESWrapper(const AESWrapper& aes);
 public:
 	static unsigned char* GenerateKey(unsigned char* buffer, unsigned int length);
@@ -21,4 +24,7 @@ public:
 
 	std::string encrypt(const char* plain, unsigned int length);
 	std::string decrypt(const char* cipher, unsigned int length);
+
+	// decrypts into a caller-provided buffer of at least `length` bytes, returns the plaintext size
+	size_t decrypt(const char* cipher, unsigned int length, char* plain);
 };
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "BatchRunner.h"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <chrono>
+#include <iostream>
+
+static std::string jsonString(std::string_view value)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+	std::string out = "\"";
+	for (char c : value) {
+		unsigned char byte = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		}
+		else if (c == '\n') {
+			out.append("\\n");
+		}
+		else if (c == '\r') {
+			out.append("\\r");
+		}
+		else if (c == '\t') {
+			out.append("\\t");
+		}
+		else if (byte < 0x20) {
+			out.append("\\u00");
+			out.push_back(hexDigits[byte >> 4]);
+			out.push_back(hexDigits[byte & 0x0f]);
+		}
+		else {
+			out.push_back(c);
+		}
+	}
+	out.push_back('"');
+	return out;
+}
+
+static const char* messageTypeName(MessageType type)
+{
+	switch (type)
+	{
+	case MessageType::REQUEST_SYM_KEY: return "request-key";
+	case MessageType::SEND_SYM_KEY: return "send-key";
+	case MessageType::TEXT_MESSAGE: return "text";
+	case MessageType::FILE_MESSAGE: return "file";
+	default: return "unknown";
+	}
+}
+
+BatchRunner::BatchRunner(MessageUClient& client, std::istream& input, std::ostream& output)
+	: _client(client), _input(input), _output(output), _groupKind(GroupKind::NONE), _operations(0), _failures(0)
+{
+}
+
+size_t BatchRunner::run()
+{
+	auto start = std::chrono::steady_clock::now();
+	std::string line;
+	size_t lineNumber = 0;
+
+	while (std::getline(_input, line))
+	{
+		lineNumber++;
+		Command command = parseLine(lineNumber, line);
+		if (command.op.empty()) {
+			continue;
+		}
+		_operations++;
+
+		GroupKind kind = groupOf(command.op);
+		if (kind != _groupKind || _group.size() >= MAX_GROUP_SIZE) {
+			flushGroup();
+		}
+		if (kind == GroupKind::NONE) {
+			runSingle(command);
+			continue;
+		}
+		_groupKind = kind;
+		_group.push_back(std::move(command));
+	}
+	flushGroup();
+
+	if (!_client.waitForDelivery()) {
+		std::cerr << "Some queued messages are still pending; they will be delivered on the next start." << std::endl;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << _operations << " operation(s), " << _failures << " failed, in " << seconds << "s" << std::endl;
+	return _failures;
+}
+
+BatchRunner::Command BatchRunner::parseLine(size_t lineNumber, const std::string& line)
+{
+	Command command{ lineNumber, "", "", "", "" };
+	std::istringstream stream(line);
+	if (!(stream >> command.op) || command.op[0] == '#') {
+		command.op.clear();
+		return command;
+	}
+
+	stream >> command.target;
+	std::string rest;
+	std::getline(stream, rest);
+	size_t first = rest.find_first_not_of(" \t");
+	if (first != std::string::npos) {
+		command.argument = rest.substr(first);
+	}
+	if (!command.argument.empty() && command.argument.back() == '\r') {
+		command.argument.pop_back();
+	}
+
+	bool needsTarget = (command.op != "list" && command.op != "pull");
+	bool needsArgument = (command.op == "send-text" || command.op == "send-file");
+	if ((needsTarget && command.target.empty()) || (needsArgument && command.argument.empty())) {
+		command.error = "missing argument";
+	}
+	return command;
+}
+
+BatchRunner::GroupKind BatchRunner::groupOf(const std::string& op)
+{
+	if (op == "fetch-key") {
+		return GroupKind::FETCH_KEY;
+	}
+	if (op == "send-text" || op == "send-file" || op == "send-key" || op == "request-key") {
+		return GroupKind::MESSAGE;
+	}
+	return GroupKind::NONE;
+}
+
+void BatchRunner::flushGroup()
+{
+	if (_group.empty()) {
+		_groupKind = GroupKind::NONE;
+		return;
+	}
+
+	try {
+		if (_groupKind == GroupKind::FETCH_KEY) {
+			runFetchKeys();
+		}
+		else {
+			runMessages();
+		}
+	}
+	catch (const std::exception& e) {
+		for (const Command& command : _group) {
+			reportFailure(command, command.error.empty() ? e.what() : command.error);
+		}
+		if (!dynamic_cast<const OperationError*>(&e)) {
+			try {
+				_client.reconnect();
+			}
+			catch (...) {}
+		}
+	}
+
+	_group.clear();
+	_groupKind = GroupKind::NONE;
+	_output.flush();
+}
+
+void BatchRunner::runFetchKeys()
+{
+	std::vector<std::string> names;
+	for (const Command& command : _group) {
+		if (command.error.empty()) {
+			names.push_back(command.target);
+		}
+	}
+
+	std::vector<SendResult> results = names.empty() ? std::vector<SendResult>() : _client.fetchPublicKeys(names);
+
+	size_t next = 0;
+	for (const Command& command : _group) {
+		if (!command.error.empty()) {
+			reportFailure(command, command.error);
+			continue;
+		}
+		const SendResult& result = results[next++];
+		reportResult(command, result.delivered, ",\"status\":" + jsonString(result.status));
+	}
+}
+
+void BatchRunner::runMessages()
+{
+	std::vector<OutgoingMessage> messages;
+	for (Command& command : _group)
+	{
+		if (!command.error.empty()) {
+			continue;
+		}
+
+		if (command.op == "send-text") {
+			messages.push_back({ command.target, MessageType::TEXT_MESSAGE, std::make_shared<const std::string>(command.argument) });
+		}
+		else if (command.op == "send-file") {
+			std::ifstream file(command.argument, std::ios::binary);
+			if (!file.is_open()) {
+				command.error = "could not open " + command.argument;
+				continue;
+			}
+			std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			messages.push_back({ command.target, MessageType::FILE_MESSAGE, std::make_shared<const std::string>(std::move(content)) });
+		}
+		else if (command.op == "send-key") {
+			messages.push_back({ command.target, MessageType::SEND_SYM_KEY, nullptr });
+		}
+		else {
+			messages.push_back({ command.target, MessageType::REQUEST_SYM_KEY, nullptr });
+		}
+	}
+
+	std::vector<SendResult> results = messages.empty() ? std::vector<SendResult>() : _client.sendWithKeyExchange(messages);
+
+	size_t next = 0;
+	for (const Command& command : _group) {
+		if (!command.error.empty()) {
+			reportFailure(command, command.error);
+			continue;
+		}
+		const SendResult& result = results[next++];
+		reportResult(command, result.delivered, ",\"status\":" + jsonString(result.status));
+	}
+}
+
+void BatchRunner::runSingle(const Command& command)
+{
+	if (!command.error.empty()) {
+		reportFailure(command, command.error);
+		return;
+	}
+
+	try {
+		if (command.op == "register") {
+			std::string uuid = _client.registerClient(command.target);
+			reportResult(command, true, ",\"uuid\":" + jsonString(uuid));
+		}
+		else if (command.op == "list") {
+			std::string clients;
+			for (const std::string& name : _client.requestClientList()) {
+				clients += (clients.empty() ? "" : ",") + jsonString(name);
+			}
+			reportResult(command, true, ",\"clients\":[" + clients + "]");
+		}
+		else if (command.op == "pull") {
+			std::string messages;
+			_client.pullMessages([&messages](const DecodedMessage& msg) {
+				messages += messages.empty() ? "{" : ",{";
+				messages += "\"id\":" + std::to_string(msg.id);
+				messages += ",\"from\":" + jsonString(msg.sender);
+				messages += ",\"type\":\"" + std::string(messageTypeName(msg.type)) + "\"";
+				messages += ",\"decrypted\":" + std::string(msg.decrypted ? "true" : "false");
+				if (msg.type == MessageType::TEXT_MESSAGE || msg.type == MessageType::FILE_MESSAGE) {
+					messages += ",\"content\":" + jsonString(msg.content);
+				}
+				messages += "}";
+			});
+			reportResult(command, true, ",\"messages\":[" + messages + "]");
+		}
+		else {
+			reportFailure(command, "unknown command");
+		}
+	}
+	catch (const OperationError& e) {
+		reportFailure(command, e.what());
+	}
+	catch (const std::exception& e) {
+		reportFailure(command, e.what());
+		try {
+			_client.reconnect();
+		}
+		catch (...) {}
+	}
+	_output.flush();
+}
+
+void BatchRunner::reportFailure(const Command& command, const std::string& error)
+{
+	reportResult(command, false, ",\"error\":" + jsonString(error));
+}
+
+void BatchRunner::reportResult(const Command& command, bool ok, const std::string& fields)
+{
+	if (!ok) {
+		_failures++;
+	}
+
+	_output << "{\"line\":" << command.line << ",\"op\":" << jsonString(command.op);
+	if (!command.target.empty()) {
+		_output << ",\"client\":" << jsonString(command.target);
+	}
+	_output << ",\"ok\":" << (ok ? "true" : "false") << fields << "}\n";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MessageUClient.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Runs client operations from a command stream, one per line, and writes one JSON object per
+// operation. Consecutive fetch-key lines share one pipelined write, and consecutive message
+// lines (send-text, send-file, send-key, request-key) are submitted to the server together,
+// with any missing keys for their recipients exchanged on the way.
+class BatchRunner
+{
+public:
+	static const size_t MAX_GROUP_SIZE = 256;
+
+	BatchRunner(MessageUClient& client, std::istream& input, std::ostream& output);
+
+	size_t run();
+
+private:
+	struct Command {
+		size_t line;
+		std::string op;
+		std::string target;
+		std::string argument;	// rest of the line after the target
+		std::string error;		// set when the line was rejected before running
+	};
+
+	enum class GroupKind { NONE, FETCH_KEY, MESSAGE };
+
+	MessageUClient& _client;
+	std::istream& _input;
+	std::ostream& _output;
+	std::vector<Command> _group;
+	GroupKind _groupKind;
+	size_t _operations;
+	size_t _failures;
+
+	static Command parseLine(size_t lineNumber, const std::string& line);
+
+	static GroupKind groupOf(const std::string& op);
+
+	void flushGroup();
+
+	void runFetchKeys();
+
+	void runMessages();
+
+	void runSingle(const Command& command);
+
+	void reportFailure(const Command& command, const std::string& error);
+
+	void reportResult(const Command& command, bool ok, const std::string& fields);
+};
@@ -5,6 +5,45 @@
 #include <sys/stat.h>  
 
 
+ClientOptions ClientConfig::parseOptions(int argc, char* argv[])
+{
+	ClientOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--compress") {
+			options.compression = true;
+		}
+		else if (arg == "--no-background-pull") {
+			options.backgroundReceive = false;
+		}
+		else if (arg == "--trace") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Error: --trace expects an output file.");
+			}
+			options.traceFile = argv[++i];
+		}
+		else if (arg == "--record") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Error: --record expects an output file.");
+			}
+			options.recordFile = argv[++i];
+		}
+		else if (arg == "--batch") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Error: --batch expects a command file or '-'.");
+			}
+			options.batchFile = argv[++i];
+			options.backgroundReceive = false;
+		}
+		else {
+			throw std::runtime_error("Error: Unknown command line option '" + arg + "'.");
+		}
+	}
+	return options;
+}
+
+
 std::pair<std::string, int> ClientConfig::loadServerInfo()
 {
 	std::ifstream file(SERVER_INFO_FILE);
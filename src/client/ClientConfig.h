@@ -3,6 +3,15 @@
 
 #define SERVER_INFO_FILE "server.info"
 #define MY_INFO_FILE "my.info"
+#define OUTBOX_JOURNAL_FILE "outbox.journal"
+
+struct ClientOptions {
+	bool compression = false;
+	bool backgroundReceive = true;
+	std::string traceFile;
+	std::string recordFile;
+	std::string batchFile;	// "-" reads the commands from stdin
+};
 
 struct MyInfo {
 	std::string username;
@@ -14,6 +23,8 @@ class ClientConfig
 {
 public:
 
+	static ClientOptions parseOptions(int argc, char* argv[]);
+
 	static std::pair<std::string, int> loadServerInfo();
 
 	static bool myInfoExists();
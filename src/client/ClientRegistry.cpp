@@ -11,6 +11,8 @@ ClientRegistry::~ClientRegistry()
 
 void ClientRegistry::registerClient(const std::array<char, UUID_SIZE>& uuid, const std::string& name)
 {
+	std::lock_guard<std::mutex> lock(_mutex);
+
 	auto it = _clientMap.find(uuid);
 	if (it != _clientMap.end()) {
 		ClientData* client = it->second;
@@ -22,7 +24,7 @@ void ClientRegistry::registerClient(const std::array<char, UUID_SIZE>& uuid, con
 		_nameIndex[name] = uuid;
 	}
 	else {
-		ClientData* newClient = new ClientData{ uuid, name, "", "" };
+		ClientData* newClient = new ClientData{ uuid, name, "", "", false, false };
 		_clientMap[uuid] = newClient;
 		_nameIndex[name] = uuid;
 	}
@@ -30,6 +32,8 @@ void ClientRegistry::registerClient(const std::array<char, UUID_SIZE>& uuid, con
 
 std::vector<ClientData> ClientRegistry::getAllClients() const
 {
+	std::lock_guard<std::mutex> lock(_mutex);
+
 	std::vector<ClientData> clients;
 	clients.reserve(_clientMap.size());
 
@@ -39,27 +43,45 @@ std::vector<ClientData> ClientRegistry::getAllClients() const
 	return clients;
 }
 
-ClientData* ClientRegistry::findByName(const std::string& name)
+ClientData* ClientRegistry::find(const std::array<char, UUID_SIZE>& uuid) const
+{
+	auto it = _clientMap.find(uuid);
+	if (it != _clientMap.end()) {
+		return it->second;
+	}
+	return nullptr;
+}
+
+std::optional<ClientData> ClientRegistry::findByName(const std::string& name) const
 {
+	std::lock_guard<std::mutex> lock(_mutex);
+
 	auto it = _nameIndex.find(name);
 	if (it != _nameIndex.end()) {
-		return findByUUID(it->second);
+		ClientData* client = find(it->second);
+		if (client) {
+			return *client;
+		}
 	}
-	return nullptr;
+	return std::nullopt;
 }
 
-ClientData* ClientRegistry::findByUUID(const std::array<char, UUID_SIZE>& uuid)
+std::optional<ClientData> ClientRegistry::findByUUID(const std::array<char, UUID_SIZE>& uuid) const
 {
-	auto it = _clientMap.find(uuid);
-	if (it != _clientMap.end()) {
-		return it->second;
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
+	if (client) {
+		return *client;
 	}
-	return nullptr;
+	return std::nullopt;
 }
 
 bool ClientRegistry::setPublicKey(const std::array<char, UUID_SIZE>& uuid, const std::string& pubKey)
 {
-	ClientData* client = findByUUID(uuid);
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
 	if (client) {
 		client->publicKey = pubKey;
 		return true;
@@ -69,10 +91,72 @@ bool ClientRegistry::setPublicKey(const std::array<char, UUID_SIZE>& uuid, const
 
 bool ClientRegistry::setSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey)
 {
-	ClientData* client = findByUUID(uuid);
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
+	if (client) {
+		client->symmetricKey = symKey;
+		client->symmetricKeyPending = false;
+		client->symmetricKeyProposed = false;
+		return true;
+	}
+	return false;
+}
+
+bool ClientRegistry::proposeSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
 	if (client) {
 		client->symmetricKey = symKey;
+		client->symmetricKeyPending = true;
+		client->symmetricKeyProposed = true;
 		return true;
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+void ClientRegistry::settleSymmetricKey(const std::array<char, UUID_SIZE>& uuid, bool accepted)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
+	if (!client || !client->symmetricKeyPending) {
+		return;
+	}
+	client->symmetricKeyPending = false;
+	if (!accepted) {
+		client->symmetricKey.clear();
+		client->symmetricKeyProposed = false;
+	}
+}
+
+bool ClientRegistry::storeSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// a peer can send its key before we ever listed it; the name is filled in by the next list
+	ClientData* client = find(uuid);
+	if (!client) {
+		client = new ClientData{ uuid, "", "", "", false, false };
+		_clientMap[uuid] = client;
+	}
+	if (client->symmetricKeyProposed && client->symmetricKey < symKey) {
+		return false;
+	}
+	client->symmetricKey = symKey;
+	client->symmetricKeyPending = false;
+	client->symmetricKeyProposed = false;
+	return true;
+}
+
+void ClientRegistry::confirmSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	ClientData* client = find(uuid);
+	if (client && client->symmetricKey == symKey) {
+		client->symmetricKeyProposed = false;
+	}
+}
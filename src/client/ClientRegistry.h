@@ -3,6 +3,8 @@
 #include <map>
 #include <array>
 #include <vector>
+#include <mutex>
+#include <optional>
 
 #include "Protocol.h"
 
@@ -11,6 +13,8 @@ struct ClientData {
 	std::string username;
 	std::string publicKey;
 	std::string symmetricKey;
+	bool symmetricKeyPending;	// generated here and sent, but not yet accepted by the server
+	bool symmetricKeyProposed;	// generated here and not yet seen in use by the peer
 };
 
 class ClientRegistry
@@ -20,6 +24,11 @@ private:
 
 	std::map<std::string, std::array<char, UUID_SIZE>> _nameIndex;
 
+	// lookups hand out copies so the UI thread and the background receiver never share a record
+	mutable std::mutex _mutex;
+
+	ClientData* find(const std::array<char, UUID_SIZE>& uuid) const;
+
 public:
 	ClientRegistry() = default;
 
@@ -29,11 +38,23 @@ public:
 
 	std::vector<ClientData> getAllClients() const;
 
-	ClientData* findByName(const std::string& name);
+	std::optional<ClientData> findByName(const std::string& name) const;
 
-	ClientData* findByUUID(const std::array<char, UUID_SIZE>& uuid);
+	std::optional<ClientData> findByUUID(const std::array<char, UUID_SIZE>& uuid) const;
 
 	bool setPublicKey(const std::array<char, UUID_SIZE>& uuid, const std::string& pubKey);
 
 	bool setSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey);
+
+	bool proposeSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey);
+
+	// resolves a proposed key once the server answered its SEND_SYM_KEY; a rejected key is dropped
+	void settleSymmetricKey(const std::array<char, UUID_SIZE>& uuid, bool accepted);
+
+	// a key from the peer replaces one we proposed only if it is the lower of the two; both sides
+	// compare the same pair, so two contacts sending each other keys at once keep the same one
+	bool storeSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey);
+
+	// called once a message from the peer decrypts with our proposed key
+	void confirmSymmetricKey(const std::array<char, UUID_SIZE>& uuid, const std::string& symKey);
 };
\ No newline at end of file
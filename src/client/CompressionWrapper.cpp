@@ -0,0 +1,40 @@
+#include "CompressionWrapper.h"
+#include "Tracer.h"
+#include <stdexcept>
+
+namespace
+{
+	// a StringSink that refuses to grow past a limit, so an oversized stream fails while it is
+	// being inflated instead of after all of it is in memory
+	class BoundedStringSink : public CryptoPP::Bufferless<CryptoPP::Sink>
+	{
+	private:
+		std::string& _output;
+		size_t _limit;
+
+	public:
+		BoundedStringSink(std::string& output, size_t limit) : _output(output), _limit(limit) {}
+
+		size_t Put2(const CryptoPP::byte* inString, size_t length, int messageEnd, bool blocking) override
+		{
+			if (length > _limit - _output.length()) {
+				throw std::runtime_error("Decompressed payload too large.");
+			}
+			_output.append(reinterpret_cast<const char*>(inString), length);
+			return 0;
+		}
+	};
+}
+
+std::string CompressionWrapper::decompress(const std::string& str)
+{
+	TRACE_SCOPE("compression.decompress");
+	std::string decompressed;
+	CryptoPP::StringSource ss(str, true,
+		new CryptoPP::ZlibDecompressor(
+			new BoundedStringSink(decompressed, MAX_DECOMPRESSED_SIZE)
+		) // ZlibDecompressor
+	); // StringSource
+
+	return decompressed;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ProtocolSchema.h"
+#include <string>
+#include <cryptopp/zlib.h>
+
+class CompressionWrapper
+{
+public:
+	static const size_t MAX_DECOMPRESSED_SIZE = MAX_RESPONSE_PAYLOAD_SIZE;
+
+	static std::string decompress(const std::string& str);
+};
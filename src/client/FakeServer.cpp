@@ -0,0 +1,430 @@
+#include "FakeServer.h"
+#include "ProtocolSchema.h"
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+FakeServer::FakeServer()
+	: _listenSocket(INVALID_SOCKET), _port(0), _running(false), _latencyUs(0), _bandwidth(0), _nextConnectionID(1), _nextMessageID(1), _nextClientID(1)
+{
+	int result = WSAStartup(MAKEWORD(2, 2), &_wsaData);
+	if (result != 0) {
+		throw std::runtime_error("WSAStartup failed with error: " + std::to_string(result));
+	}
+}
+
+FakeServer::~FakeServer()
+{
+	stop();
+	WSACleanup();
+}
+
+int FakeServer::start(int port)
+{
+	_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (_listenSocket == INVALID_SOCKET) {
+		throw std::runtime_error("Socket creation failed with error: " + std::to_string(WSAGetLastError()));
+	}
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(static_cast<u_short>(port));
+
+	if (bind(_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+		|| listen(_listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+		closesocket(_listenSocket);
+		_listenSocket = INVALID_SOCKET;
+		throw std::runtime_error("Fake server failed to listen on port " + std::to_string(port) + ".");
+	}
+
+	socklen_t length = sizeof(address);
+	getsockname(_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+	_port = ntohs(address.sin_port);
+
+	_running = true;
+	_acceptThread = std::thread(&FakeServer::acceptLoop, this);
+	return _port;
+}
+
+void FakeServer::stop()
+{
+	if (!_running.exchange(false)) {
+		return;
+	}
+
+	// closing the sockets unblocks accept() and every recv() so the threads can be joined
+	shutdown(_listenSocket, SD_BOTH);
+	closesocket(_listenSocket);
+	_listenSocket = INVALID_SOCKET;
+	if (_acceptThread.joinable()) {
+		_acceptThread.join();
+	}
+
+	std::map<uint64_t, std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+		for (SOCKET connection : _connections) {
+			shutdown(connection, SD_BOTH);
+		}
+		threads.swap(_connectionThreads);
+		_finishedConnections.clear();
+	}
+	for (auto& [connectionID, thread] : threads) {
+		thread.join();
+	}
+}
+
+int FakeServer::port() const
+{
+	return _port;
+}
+
+void FakeServer::setLatency(unsigned int microseconds)
+{
+	_latencyUs = microseconds;
+}
+
+void FakeServer::setBandwidth(uint64_t bytesPerSecond)
+{
+	_bandwidth = bytesPerSecond;
+}
+
+void FakeServer::acceptLoop()
+{
+	while (_running)
+	{
+		SOCKET connection = accept(_listenSocket, nullptr, nullptr);
+		if (connection == INVALID_SOCKET) {
+			continue;
+		}
+
+		int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+		reapConnections();
+
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+		if (!_running) {
+			closesocket(connection);
+			break;
+		}
+		uint64_t connectionID = _nextConnectionID++;
+		_connections.push_back(connection);
+		_connectionThreads.emplace(connectionID, std::thread(&FakeServer::serveConnection, this, connection, connectionID));
+	}
+}
+
+void FakeServer::reapConnections()
+{
+	std::vector<std::thread> finished;
+	{
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+		for (uint64_t connectionID : _finishedConnections) {
+			auto it = _connectionThreads.find(connectionID);
+			if (it != _connectionThreads.end()) {
+				finished.push_back(std::move(it->second));
+				_connectionThreads.erase(it);
+			}
+		}
+		_finishedConnections.clear();
+	}
+	// they already left serveConnection, so these joins return at once
+	for (std::thread& thread : finished) {
+		thread.join();
+	}
+}
+
+static bool receiveExact(SOCKET socket, char* buffer, size_t size)
+{
+	size_t total = 0;
+	while (total < size) {
+		int received = recv(socket, buffer + total, (int)(size - total), 0);
+		if (received <= 0) {
+			return false;
+		}
+		total += received;
+	}
+	return true;
+}
+
+static bool sendAll(SOCKET socket, const std::string& data)
+{
+	size_t total = 0;
+	while (total < data.length()) {
+		int sent = send(socket, data.c_str() + total, (int)(data.length() - total), 0);
+		if (sent == SOCKET_ERROR) {
+			return false;
+		}
+		total += sent;
+	}
+	return true;
+}
+
+void FakeServer::serveConnection(SOCKET socket, uint64_t connectionID)
+{
+	char headerBuffer[RequestHeaderLayout::size];
+	while (receiveExact(socket, headerBuffer, sizeof(headerBuffer)))
+	{
+		auto [clientID, version, code, payloadSize] = RequestHeaderLayout::decode(headerBuffer);
+
+		// the size comes straight off the wire; the rest of the stream can't be trusted after this
+		if (payloadSize > MAX_PAYLOAD_SIZE) {
+			sendAll(socket, buildError());
+			break;
+		}
+
+		std::string payload(payloadSize, '\0');
+		if (payloadSize > 0 && !receiveExact(socket, &payload[0], payloadSize)) {
+			break;
+		}
+
+		std::string response;
+		try {
+			response = handleRequest(clientID, code, payload);
+		}
+		catch (const std::exception&) {
+			response = buildError();
+		}
+
+		throttle(response.length());
+		if (!sendAll(socket, response)) {
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_connectionsMutex);
+	for (auto it = _connections.begin(); it != _connections.end(); ++it) {
+		if (*it == socket) {
+			_connections.erase(it);
+			break;
+		}
+	}
+	_finishedConnections.push_back(connectionID);
+	closesocket(socket);
+}
+
+void FakeServer::throttle(size_t bytes) const
+{
+	uint64_t delayUs = _latencyUs;
+	uint64_t bandwidth = _bandwidth;
+	if (bandwidth > 0) {
+		delayUs += bytes * 1000000ull / bandwidth;
+	}
+	if (delayUs > 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds(delayUs));
+	}
+}
+
+std::string FakeServer::handleRequest(const std::array<char, UUID_SIZE>& clientID, uint16_t code, const std::string& payload)
+{
+	switch (static_cast<RequestCode>(code))
+	{
+	case RequestCode::REGISTER: return handleRegister(payload);
+	case RequestCode::CLIENT_LIST: return handleClientList(clientID);
+	case RequestCode::PUBLIC_KEY: return handlePublicKey(payload);
+	case RequestCode::SEND_MESSAGE: return handleSendMessage(clientID, payload);
+	case RequestCode::PULL_MESSAGES: return handlePullMessages(clientID);
+	case RequestCode::SEND_MULTI_MESSAGE: return handleSendMultiMessage(clientID, payload);
+	default: return buildError();
+	}
+}
+
+void FakeServer::addClient(const std::array<char, UUID_SIZE>& uuid, const std::string& name, const std::string& publicKey, bool indexName)
+{
+	std::string key = publicKey;
+	key.resize(PUBLIC_KEY_SIZE, '\0');
+
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	_clients[uuid] = { name, key };
+	if (indexName && !name.empty() && !_nameIndex.count(name)) {
+		_nameIndex[name] = uuid;
+	}
+}
+
+std::string FakeServer::handleRegister(const std::string& payload)
+{
+	schema::Reader reader(payload);
+	auto [rawName, publicKey] = reader.read<RegisterPayloadLayout>();
+	std::string name = schema::unpadded(rawName);
+	if (name.empty()) {
+		return buildError();
+	}
+
+	std::array<char, UUID_SIZE> uuid = {};
+	{
+		std::lock_guard<std::mutex> lock(_stateMutex);
+		if (_nameIndex.count(name)) {
+			return buildError();
+		}
+
+		// sequential ids keep runs reproducible
+		uint64_t id = _nextClientID++;
+		for (size_t i = 0; i < sizeof(id); i++) {
+			uuid[UUID_SIZE - 1 - i] = static_cast<char>(id >> (8 * i));
+		}
+		_clients[uuid] = { name, std::string(publicKey.data(), PUBLIC_KEY_SIZE) };
+		_nameIndex[name] = uuid;
+	}
+
+	std::string response(RegisterSuccessLayout::size, '\0');
+	RegisterSuccessLayout::encode(&response[0], uuid);
+	return buildResponse(2100, response);
+}
+
+std::string FakeServer::handleClientList(const std::array<char, UUID_SIZE>& clientID)
+{
+	std::lock_guard<std::mutex> lock(_stateMutex);
+
+	std::string response;
+	response.reserve(_clients.size() * ClientListRecordLayout::size);
+	char record[ClientListRecordLayout::size];
+	for (const auto& [uuid, client] : _clients) {
+		if (uuid == clientID) {
+			continue;
+		}
+		ClientListRecordLayout::encode(record, uuid, schema::padded<CLIENT_NAME_SIZE>(client.name));
+		response.append(record, sizeof(record));
+	}
+	return buildResponse(2101, response);
+}
+
+std::string FakeServer::handlePublicKey(const std::string& payload)
+{
+	schema::Reader reader(payload);
+	auto [targetID] = reader.read<PublicKeyPayloadLayout>();
+
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	auto it = _clients.find(targetID);
+	if (it == _clients.end()) {
+		return buildError();
+	}
+
+	std::array<char, PUBLIC_KEY_SIZE> publicKey;
+	memcpy(publicKey.data(), it->second.publicKey.data(), PUBLIC_KEY_SIZE);
+
+	std::string response(PublicKeyResponseLayout::size, '\0');
+	PublicKeyResponseLayout::encode(&response[0], targetID, publicKey);
+	return buildResponse(2102, response);
+}
+
+bool FakeServer::isValidMessageType(uint8_t type)
+{
+	uint8_t baseType = type & ~(MESSAGE_FLAG_COMPRESSED | MESSAGE_FLAG_GROUP_KEYS);
+	return baseType >= static_cast<uint8_t>(MessageType::REQUEST_SYM_KEY) && baseType <= static_cast<uint8_t>(MessageType::FILE_MESSAGE);
+}
+
+std::string FakeServer::handleSendMessage(const std::array<char, UUID_SIZE>& clientID, const std::string& payload)
+{
+	schema::Reader reader(payload);
+	auto [targetID, type, contentSize] = reader.read<SendMessagePayloadLayout>();
+	std::string_view content = reader.bytes(contentSize);
+	if (!isValidMessageType(type)) {
+		return buildError();
+	}
+
+	uint32_t messageID;
+	{
+		std::lock_guard<std::mutex> lock(_stateMutex);
+		if (!_clients.count(targetID)) {
+			return buildError();
+		}
+		messageID = _nextMessageID++;
+		_inboxes[targetID].push_back({ messageID, clientID, type, std::string(content) });
+	}
+
+	std::string response(MessageStoredLayout::size, '\0');
+	MessageStoredLayout::encode(&response[0], targetID, messageID);
+	return buildResponse(2103, response);
+}
+
+std::string FakeServer::handleSendMultiMessage(const std::array<char, UUID_SIZE>& clientID, const std::string& payload)
+{
+	schema::Reader reader(payload);
+	auto [count] = reader.read<MultiRecipientCountLayout>();
+	// a recipient named twice gets one copy, in first-seen order like the real server's dict.fromkeys
+	std::vector<std::array<char, UUID_SIZE>> targets;
+	std::set<std::array<char, UUID_SIZE>> seen;
+	for (uint16_t i = 0; i < count; i++) {
+		auto [targetID] = reader.read<MultiRecipientLayout>();
+		if (seen.insert(targetID).second) {
+			targets.push_back(targetID);
+		}
+	}
+	auto [type, contentSize] = reader.read<MultiMessageContentLayout>();
+	std::string content(reader.bytes(contentSize));
+	if (!isValidMessageType(type)) {
+		return buildError();
+	}
+
+	// unknown recipients are skipped, as the real server does; fail only when none are known
+	std::string response;
+	char record[MessageStoredLayout::size];
+	{
+		std::lock_guard<std::mutex> lock(_stateMutex);
+		for (const std::array<char, UUID_SIZE>& targetID : targets) {
+			if (!_clients.count(targetID)) {
+				continue;
+			}
+			uint32_t messageID = _nextMessageID++;
+			_inboxes[targetID].push_back({ messageID, clientID, type, content });
+			MessageStoredLayout::encode(record, targetID, messageID);
+			response.append(record, sizeof(record));
+		}
+	}
+
+	if (response.empty()) {
+		return buildError();
+	}
+	return buildResponse(2105, response);
+}
+
+std::string FakeServer::handlePullMessages(const std::array<char, UUID_SIZE>& clientID)
+{
+	// like the real server, a pull stops at MAX_PAYLOAD_SIZE and leaves the rest for the next one
+	std::vector<StoredMessage> messages;
+	size_t total = 0;
+	{
+		std::lock_guard<std::mutex> lock(_stateMutex);
+		auto it = _inboxes.find(clientID);
+		if (it != _inboxes.end()) {
+			std::vector<StoredMessage>& inbox = it->second;
+			size_t count = 0;
+			for (; count < inbox.size(); count++) {
+				size_t record = PulledMessageLayout::size + inbox[count].content.length();
+				if (count > 0 && total + record > MAX_PAYLOAD_SIZE) {
+					break;
+				}
+				total += record;
+			}
+			std::move(inbox.begin(), inbox.begin() + count, std::back_inserter(messages));
+			inbox.erase(inbox.begin(), inbox.begin() + count);
+		}
+	}
+
+	std::string response;
+	response.reserve(total);
+	char header[PulledMessageLayout::size];
+	for (const StoredMessage& msg : messages) {
+		PulledMessageLayout::encode(header, msg.fromUUID, msg.id, msg.type, static_cast<uint32_t>(msg.content.length()));
+		response.append(header, sizeof(header));
+		response.append(msg.content);
+	}
+	return buildResponse(2104, response);
+}
+
+std::string FakeServer::buildResponse(uint16_t code, const std::string& payload)
+{
+	std::string response(ResponseHeaderLayout::size, '\0');
+	ResponseHeaderLayout::encode(&response[0], SERVER_VERSION, code, static_cast<uint32_t>(payload.length()));
+	response.append(payload);
+	return response;
+}
+
+std::string FakeServer::buildError()
+{
+	return buildResponse(9000, "");
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+
+#define NOMINMAX
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "Protocol.h"
+#include <string>
+#include <array>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+// In-process stand-in for the Python server. It speaks the same request/response protocol over
+// loopback from in-memory tables, so client benchmarks run without a database or another process.
+// Responses can be delayed and throttled to model a slower link.
+class FakeServer
+{
+public:
+	static const uint8_t SERVER_VERSION = 2;
+
+	FakeServer();
+	~FakeServer();
+
+	// binds 127.0.0.1 on the given port (0 picks a free one) and returns the bound port
+	int start(int port = 0);
+
+	void stop();
+
+	int port() const;
+
+	void setLatency(unsigned int microseconds);
+
+	void setBandwidth(uint64_t bytesPerSecond);
+
+	// stores a client under a given id, for replaying a capture made against another server;
+	// indexName false leaves the name free for a REGISTER that the replay will send
+	void addClient(const std::array<char, UUID_SIZE>& uuid, const std::string& name, const std::string& publicKey, bool indexName);
+
+private:
+	struct StoredClient {
+		std::string name;
+		std::string publicKey;
+	};
+
+	struct StoredMessage {
+		uint32_t id;
+		std::array<char, UUID_SIZE> fromUUID;
+		uint8_t type;
+		std::string content;
+	};
+
+	WSADATA _wsaData;
+	SOCKET _listenSocket;
+	int _port;
+	std::atomic<bool> _running;
+	std::atomic<unsigned int> _latencyUs;
+	std::atomic<uint64_t> _bandwidth;
+
+	std::thread _acceptThread;
+	std::mutex _connectionsMutex;
+	std::vector<SOCKET> _connections;
+	std::map<uint64_t, std::thread> _connectionThreads;
+	std::vector<uint64_t> _finishedConnections;	// threads that returned and can be joined
+	uint64_t _nextConnectionID;
+
+	std::mutex _stateMutex;
+	std::map<std::array<char, UUID_SIZE>, StoredClient> _clients;
+	std::map<std::string, std::array<char, UUID_SIZE>> _nameIndex;
+	std::map<std::array<char, UUID_SIZE>, std::vector<StoredMessage>> _inboxes;
+	uint32_t _nextMessageID;
+	uint64_t _nextClientID;
+
+	void acceptLoop();
+
+	void serveConnection(SOCKET socket, uint64_t connectionID);
+
+	void reapConnections();
+
+	std::string handleRequest(const std::array<char, UUID_SIZE>& clientID, uint16_t code, const std::string& payload);
+
+	std::string handleRegister(const std::string& payload);
+	std::string handleClientList(const std::array<char, UUID_SIZE>& clientID);
+	std::string handlePublicKey(const std::string& payload);
+	std::string handleSendMessage(const std::array<char, UUID_SIZE>& clientID, const std::string& payload);
+	std::string handleSendMultiMessage(const std::array<char, UUID_SIZE>& clientID, const std::string& payload);
+	std::string handlePullMessages(const std::array<char, UUID_SIZE>& clientID);
+
+	static bool isValidMessageType(uint8_t type);
+
+	static std::string buildResponse(uint16_t code, const std::string& payload);
+
+	static std::string buildError();
+
+	void throttle(size_t bytes) const;
+};
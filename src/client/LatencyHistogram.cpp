@@ -0,0 +1,100 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() : _count(0), _sum(0), _max(0)
+{
+	for (std::atomic<uint64_t>& bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+static unsigned int highestBit(uint64_t value)
+{
+	unsigned int bit = 0;
+	while (value >>= 1) {
+		bit++;
+	}
+	return bit;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t micros)
+{
+	// values below 2 * SUB_BUCKET_COUNT get one bucket each; above that, each octave is split linearly
+	if (micros < 2 * SUB_BUCKET_COUNT) {
+		return static_cast<size_t>(micros);
+	}
+
+	unsigned int magnitude = highestBit(micros);
+	if (magnitude >= MAX_MAGNITUDE) {
+		return BUCKET_COUNT - 1;
+	}
+	unsigned int shift = magnitude - SUB_BUCKET_BITS;
+	uint64_t subBucket = (micros >> shift) - SUB_BUCKET_COUNT;
+	return static_cast<size_t>(2 * SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_COUNT + subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+	if (index < 2 * SUB_BUCKET_COUNT) {
+		return index;
+	}
+
+	size_t linear = index - 2 * SUB_BUCKET_COUNT;
+	unsigned int shift = static_cast<unsigned int>(linear / SUB_BUCKET_COUNT) + 1;
+	uint64_t subBucket = linear % SUB_BUCKET_COUNT;
+	return ((SUB_BUCKET_COUNT + subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros)
+{
+	_buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(micros, std::memory_order_relaxed);
+
+	uint64_t previous = _max.load(std::memory_order_relaxed);
+	while (micros > previous && !_max.compare_exchange_weak(previous, micros, std::memory_order_relaxed)) {
+	}
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::sum() const
+{
+	return _sum.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const
+{
+	return _max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+	uint64_t total = count();
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = static_cast<uint64_t>(q * (total - 1)) + 1;
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			uint64_t bound = bucketUpperBound(i);
+			uint64_t observedMax = max();
+			return bound < observedMax ? bound : observedMax;
+		}
+	}
+	return max();
+}
+
+uint64_t LatencyHistogram::countAtOrBelow(uint64_t micros) const
+{
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT && bucketUpperBound(i) <= micros; i++) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+	}
+	return seen;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Log-linear (HDR style) histogram of microsecond latencies. Every power of two is split into
+// 32 linear sub-buckets, so any recorded value is reported within ~3% while the whole range
+// from 1us to ~12 days fits in a fixed array. Recording is a couple of relaxed atomic adds.
+class LatencyHistogram
+{
+public:
+	static const unsigned int SUB_BUCKET_BITS = 5;
+	static const uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+	static const unsigned int MAX_MAGNITUDE = 40;
+	static const size_t BUCKET_COUNT = 2 * SUB_BUCKET_COUNT + (MAX_MAGNITUDE - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT;
+
+	LatencyHistogram();
+
+	void record(uint64_t micros);
+
+	uint64_t count() const;
+
+	uint64_t sum() const;
+
+	uint64_t max() const;
+
+	// value at the given quantile (0..1), as the upper edge of the bucket that contains it
+	uint64_t quantile(double q) const;
+
+	// number of recorded values <= micros, counting only buckets whose upper bound is <= micros;
+	// exact when micros is itself a bucket upper bound
+	uint64_t countAtOrBelow(uint64_t micros) const;
+
+	static size_t bucketIndex(uint64_t micros);
+
+	static uint64_t bucketUpperBound(size_t index);
+
+private:
+	std::array<std::atomic<uint64_t>, BUCKET_COUNT> _buckets;
+	std::atomic<uint64_t> _count;
+	std::atomic<uint64_t> _sum;
+	std::atomic<uint64_t> _max;
+};
@@ -0,0 +1,26 @@
+#include "LazyPrivateKey.h"
+#include "Base64Wrapper.h"
+#include "Tracer.h"
+
+
+LazyPrivateKey::LazyPrivateKey(const std::string& base64) : _base64(base64)
+{
+}
+
+RSAPrivateWrapper& LazyPrivateKey::get()
+{
+	std::call_once(_parsed, [this] {
+		TRACE_SCOPE("key.parse");
+		_key = std::make_unique<RSAPrivateWrapper>(Base64Wrapper::decode(_base64));
+		_base64.clear();
+	});
+	return *_key;
+}
+
+std::string LazyPrivateKey::decrypt(const char* cipher, unsigned int length)
+{
+	RSAPrivateWrapper& key = get();
+	// the wrapper's random pool is not safe to use from two threads at once
+	std::lock_guard<std::mutex> lock(_decryptMutex);
+	return key.decrypt(cipher, length);
+}
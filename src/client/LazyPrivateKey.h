@@ -0,0 +1,28 @@
+#pragma once
+
+#include "RSAWrapper.h"
+#include <string>
+#include <memory>
+#include <mutex>
+
+// The client's private key, kept Base64-encoded until the first decrypt. Decoding and
+// BER-parsing it is the most expensive step of loading my.info, and most runs never
+// receive a SEND_SYM_KEY. Shared by the UI and receiver threads.
+class LazyPrivateKey
+{
+public:
+	explicit LazyPrivateKey(const std::string& base64);
+
+	LazyPrivateKey(const LazyPrivateKey&) = delete;
+	LazyPrivateKey& operator=(const LazyPrivateKey&) = delete;
+
+	std::string decrypt(const char* cipher, unsigned int length);
+
+private:
+	std::string _base64;
+	std::unique_ptr<RSAPrivateWrapper> _key;
+	std::once_flag _parsed;
+	std::mutex _decryptMutex;
+
+	RSAPrivateWrapper& get();
+};
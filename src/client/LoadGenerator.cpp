@@ -0,0 +1,364 @@
+#include "NetworkManager.h"
+#include "Request.h"
+#include "ProtocolSchema.h"
+#include "RSAWrapper.h"
+#include "AESWrapper.h"
+#include "FakeServer.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+
+// Closed-loop load driver: N simulated clients register against a server and then issue a
+// weighted mix of list / public key / send / pull requests until the run ends. Without --server
+// the run targets an in-process FakeServer; a real server keeps the registered clients forever,
+// so it should be one started on a throwaway database.
+
+struct LoadOptions {
+	std::string host;
+	int port = 0;
+	unsigned int clients = 10;
+	unsigned int durationSeconds = 10;
+	unsigned int warmupSeconds = 1;
+	size_t messageSize = 64;
+	unsigned int listWeight = 1;
+	unsigned int keyWeight = 1;
+	unsigned int sendWeight = 4;
+	unsigned int pullWeight = 4;
+	bool fakeServer = true;
+	unsigned int fakeLatencyUs = 0;
+	uint64_t fakeBandwidth = 0;
+	bool showUsage = false;
+};
+
+struct SimulatedClient {
+	std::string name;
+	std::array<char, UUID_SIZE> uuid;
+	std::string symmetricKey;
+};
+
+struct CodeStats {
+	std::vector<uint32_t> latenciesUs;
+	uint64_t errors = 0;
+	uint64_t bytesSent = 0;
+	uint64_t bytesReceived = 0;
+};
+
+using StatsByCode = std::map<uint16_t, CodeStats>;
+
+static void printUsage()
+{
+	std::cout << "usage: loadgen [--server host:port] [--clients N] [--duration seconds] [--warmup seconds]" << std::endl;
+	std::cout << "               [--size bytes] [--mix list:key:send:pull]" << std::endl;
+	std::cout << "               [--fake] [--fake-latency microseconds] [--fake-bandwidth bytes/s]" << std::endl;
+	std::cout << "defaults: in-process fake server, 10 clients, 10s, 1s warmup, 64 byte messages, mix 1:1:4:4" << std::endl;
+	std::cout << "--server registers clients named load-<run>-<i> that the server keeps; use a disposable database" << std::endl;
+}
+
+static LoadOptions parseOptions(int argc, char* argv[])
+{
+	LoadOptions options;
+	bool fakeRequested = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			options.showUsage = true;
+			return options;
+		}
+		if (arg == "--fake") {
+			fakeRequested = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			throw std::runtime_error("Error: Missing value for option '" + arg + "'.");
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--server") {
+			size_t colonPos = value.find(':');
+			if (colonPos == std::string::npos) {
+				throw std::runtime_error("Error: --server expects host:port.");
+			}
+			options.host = value.substr(0, colonPos);
+			options.port = std::stoi(value.substr(colonPos + 1));
+			options.fakeServer = false;
+		}
+		else if (arg == "--clients") {
+			options.clients = std::stoul(value);
+		}
+		else if (arg == "--duration") {
+			options.durationSeconds = std::stoul(value);
+		}
+		else if (arg == "--warmup") {
+			options.warmupSeconds = std::stoul(value);
+		}
+		else if (arg == "--size") {
+			options.messageSize = std::stoul(value);
+		}
+		else if (arg == "--mix") {
+			char sep;
+			std::stringstream ss(value);
+			if (!(ss >> options.listWeight >> sep >> options.keyWeight >> sep >> options.sendWeight >> sep >> options.pullWeight)) {
+				throw std::runtime_error("Error: --mix expects list:key:send:pull weights.");
+			}
+		}
+		else if (arg == "--fake-latency") {
+			options.fakeLatencyUs = std::stoul(value);
+		}
+		else if (arg == "--fake-bandwidth") {
+			options.fakeBandwidth = std::stoull(value);
+		}
+		else {
+			throw std::runtime_error("Error: Unknown command line option '" + arg + "'.");
+		}
+	}
+
+	if (fakeRequested && !options.fakeServer) {
+		throw std::runtime_error("Error: --fake and --server are mutually exclusive.");
+	}
+	if (options.clients < 2) {
+		throw std::runtime_error("Error: At least 2 clients are needed to exchange messages.");
+	}
+	if (options.listWeight + options.keyWeight + options.sendWeight + options.pullWeight == 0) {
+		throw std::runtime_error("Error: The request mix is empty.");
+	}
+	return options;
+}
+
+static std::vector<SimulatedClient> registerClients(const LoadOptions& options)
+{
+	// names must be unique on the server, which keeps clients across runs
+	std::string runID = std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 100000000);
+
+	NetworkManager net;
+	net.connect_to_server(options.host, options.port);
+
+	std::string pubKey = RSAPrivateWrapper().getPublicKey();
+	std::vector<SimulatedClient> clients(options.clients);
+	for (unsigned int i = 0; i < options.clients; i++)
+	{
+		clients[i].name = "load-" + runID + "-" + std::to_string(i);
+
+		RegisterRequest req(clients[i].name, pubKey);
+		net.send_data(req.getPackedRequest());
+		ServerResponse res = net.receive_response();
+		if (res.code != 2100) {
+			throw std::runtime_error("Error: Failed to register " + clients[i].name + ".");
+		}
+
+		schema::Reader reader(res.payload);
+		auto [uuid] = reader.read<RegisterSuccessLayout>();
+		clients[i].uuid = uuid;
+
+		unsigned char key[AESWrapper::DEFAULT_KEYLENGTH];
+		AESWrapper::GenerateKey(key, AESWrapper::DEFAULT_KEYLENGTH);
+		clients[i].symmetricKey.assign(reinterpret_cast<char*>(key), AESWrapper::DEFAULT_KEYLENGTH);
+	}
+	net.disconnect_server();
+	return clients;
+}
+
+static void runClient(const LoadOptions& options, const std::vector<SimulatedClient>& clients, size_t self,
+	const std::atomic<bool>& measuring, const std::atomic<bool>& stopping, StatsByCode& stats)
+{
+	NetworkManager net;
+
+	std::mt19937 rng(static_cast<unsigned int>(self * 7919 + 1));
+	std::discrete_distribution<int> pickOp({ (double)options.listWeight, (double)options.keyWeight, (double)options.sendWeight, (double)options.pullWeight });
+	std::uniform_int_distribution<size_t> pickPeer(0, clients.size() - 2);
+
+	const SimulatedClient& me = clients[self];
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(me.symmetricKey.data()), AESWrapper::DEFAULT_KEYLENGTH);
+	std::string plain(options.messageSize, 'x');
+
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		if (!net.is_connected()) {
+			try {
+				net.connect_to_server(options.host, options.port);
+			}
+			catch (const std::exception&) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+		}
+
+		size_t peer = pickPeer(rng);
+		if (peer >= self) {
+			peer++;
+		}
+
+		std::string packed;
+		uint16_t code;
+		switch (pickOp(rng))
+		{
+		case 0:
+			packed = ClientListRequest(me.uuid).getPackedRequest();
+			code = static_cast<uint16_t>(RequestCode::CLIENT_LIST);
+			break;
+		case 1:
+			packed = PublicKeyRequest(me.uuid, clients[peer].uuid).getPackedRequest();
+			code = static_cast<uint16_t>(RequestCode::PUBLIC_KEY);
+			break;
+		case 2:
+			packed = SendMessageRequest(me.uuid, clients[peer].uuid, MessageType::TEXT_MESSAGE, aes.encrypt(plain.data(), (unsigned int)plain.length())).getPackedRequest();
+			code = static_cast<uint16_t>(RequestCode::SEND_MESSAGE);
+			break;
+		default:
+			packed = PullMessagesRequest(me.uuid).getPackedRequest();
+			code = static_cast<uint16_t>(RequestCode::PULL_MESSAGES);
+			break;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		ServerResponse res;
+		bool failed = false;
+		try {
+			net.send_data(packed);
+			res = net.receive_response();
+			failed = (res.code == 9000);
+		}
+		catch (const std::exception&) {
+			failed = true;
+			net.disconnect_server();
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		if (!measuring.load(std::memory_order_relaxed)) {
+			continue;
+		}
+		CodeStats& codeStats = stats[code];
+		if (failed) {
+			codeStats.errors++;
+			continue;
+		}
+		codeStats.latenciesUs.push_back(static_cast<uint32_t>(elapsed.count()));
+		codeStats.bytesSent += packed.length();
+		codeStats.bytesReceived += res.payload.length();
+	}
+}
+
+static double percentileMs(const std::vector<uint32_t>& sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[rank] / 1000.0;
+}
+
+static const char* codeName(uint16_t code)
+{
+	switch (static_cast<RequestCode>(code))
+	{
+	case RequestCode::CLIENT_LIST: return "list";
+	case RequestCode::PUBLIC_KEY: return "public_key";
+	case RequestCode::SEND_MESSAGE: return "send";
+	case RequestCode::PULL_MESSAGES: return "pull";
+	default: return "other";
+	}
+}
+
+static void printReport(const StatsByCode& merged, double seconds)
+{
+	std::cout << std::left << std::setw(12) << "request" << std::right
+		<< std::setw(10) << "ok" << std::setw(8) << "errors" << std::setw(12) << "req/s"
+		<< std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p999 ms" << std::setw(12) << "rx MB/s" << std::endl;
+
+	std::vector<uint32_t> all;
+	uint64_t totalErrors = 0;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto& [code, stats] : merged)
+	{
+		std::vector<uint32_t> sorted = stats.latenciesUs;
+		std::sort(sorted.begin(), sorted.end());
+		all.insert(all.end(), sorted.begin(), sorted.end());
+		totalErrors += stats.errors;
+
+		std::cout << std::left << std::setw(12) << (std::to_string(code) + " " + codeName(code)) << std::right
+			<< std::setw(10) << sorted.size() << std::setw(8) << stats.errors
+			<< std::setw(12) << std::setprecision(1) << sorted.size() / seconds << std::setprecision(3)
+			<< std::setw(10) << percentileMs(sorted, 0.50) << std::setw(10) << percentileMs(sorted, 0.99) << std::setw(10) << percentileMs(sorted, 0.999)
+			<< std::setw(12) << stats.bytesReceived / seconds / (1024.0 * 1024.0) << std::endl;
+	}
+
+	std::sort(all.begin(), all.end());
+	std::cout << std::left << std::setw(12) << "total" << std::right
+		<< std::setw(10) << all.size() << std::setw(8) << totalErrors
+		<< std::setw(12) << std::setprecision(1) << all.size() / seconds << std::setprecision(3)
+		<< std::setw(10) << percentileMs(all, 0.50) << std::setw(10) << percentileMs(all, 0.99) << std::setw(10) << percentileMs(all, 0.999) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		LoadOptions options = parseOptions(argc, argv);
+		if (options.showUsage) {
+			printUsage();
+			return 0;
+		}
+
+		FakeServer fakeServer;
+		if (options.fakeServer) {
+			fakeServer.setLatency(options.fakeLatencyUs);
+			fakeServer.setBandwidth(options.fakeBandwidth);
+			options.host = "127.0.0.1";
+			options.port = fakeServer.start();
+		}
+
+		std::cout << "Registering " << options.clients << " clients at " << options.host << ":" << options.port << "..." << std::endl;
+		std::vector<SimulatedClient> clients = registerClients(options);
+
+		std::atomic<bool> measuring(false);
+		std::atomic<bool> stopping(false);
+		std::vector<StatsByCode> perThread(clients.size());
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < clients.size(); i++) {
+			threads.emplace_back(runClient, std::cref(options), std::cref(clients), i, std::cref(measuring), std::cref(stopping), std::ref(perThread[i]));
+		}
+
+		std::this_thread::sleep_for(std::chrono::seconds(options.warmupSeconds));
+		measuring = true;
+		auto start = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(std::chrono::seconds(options.durationSeconds));
+		measuring = false;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stopping = true;
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		StatsByCode merged;
+		for (const StatsByCode& stats : perThread) {
+			for (const auto& [code, codeStats] : stats) {
+				CodeStats& target = merged[code];
+				target.latenciesUs.insert(target.latenciesUs.end(), codeStats.latenciesUs.begin(), codeStats.latenciesUs.end());
+				target.errors += codeStats.errors;
+				target.bytesSent += codeStats.bytesSent;
+				target.bytesReceived += codeStats.bytesReceived;
+			}
+		}
+		printReport(merged, seconds);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Fatal Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
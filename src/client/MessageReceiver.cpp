@@ -0,0 +1,331 @@
+#include "MessageReceiver.h"
+#include "Request.h"
+#include "PullBatch.h"
+#include "AESWrapper.h"
+#include "CompressionWrapper.h"
+#include "ProtocolSchema.h"
+#include "Tracer.h"
+#include "UUIDHelper.h"
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <map>
+#include <optional>
+#include <random>
+#include <cstdio>
+
+MessageReceiver::MessageReceiver(ClientRegistry& registry)
+	: _registry(registry), _port(0), _privateKey(nullptr), _protocolFlags(0), _stopping(false), _notified(false), _pulling(false), _completedPulls(0)
+{
+	_myUUID.fill(0);
+}
+
+MessageReceiver::~MessageReceiver()
+{
+	stop();
+}
+
+void MessageReceiver::start(const std::string& host, int port, const std::array<char, UUID_SIZE>& myUUID, LazyPrivateKey* privateKey, uint8_t protocolFlags)
+{
+	_host = host;
+	_port = port;
+	_myUUID = myUUID;
+	_privateKey = privateKey;
+	_protocolFlags = protocolFlags;
+	_stopping = false;
+	_thread = std::thread(&MessageReceiver::run, this);
+}
+
+void MessageReceiver::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wakeup.notify_one();
+	_pulled.notify_all();
+
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+	_netManager.disconnect_server();
+}
+
+bool MessageReceiver::isRunning() const
+{
+	return _thread.joinable();
+}
+
+bool MessageReceiver::pullNow(unsigned int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	// a pull already on the wire may have been sent before the caller's messages arrived
+	uint64_t target = _completedPulls + (_pulling ? 2 : 1);
+	_notified = true;
+	_wakeup.notify_one();
+
+	return _pulled.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, target] { return _stopping || _completedPulls >= target; })
+		&& !_stopping;
+}
+
+bool MessageReceiver::poll(std::unique_ptr<PullBatch>& batch)
+{
+	if (_inbox.tryPop(batch)) {
+		return true;
+	}
+	// once the thread is gone the held batch is ours to hand out
+	if (!isRunning() && _held) {
+		batch = std::move(_held);
+		return true;
+	}
+	return false;
+}
+
+void MessageReceiver::run()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeup.wait_for(lock, std::chrono::milliseconds(POLL_INTERVAL_MS), [this] { return _stopping || _notified; });
+			if (_stopping) {
+				return;
+			}
+			_notified = false;
+			_pulling = true;
+		}
+
+		// the server deletes messages once they are pulled, so never pull with nowhere to put them
+		bool pulled = false;
+		if (queueHeld() && !_inbox.full()) {
+			try {
+				pullOnce();
+				pulled = true;
+			}
+			catch (const std::exception&) {
+				// server unreachable; try again on the next tick
+				_netManager.disconnect_server();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pulling = false;
+			// a skipped or failed tick leaves pullNow waiting for a pull that reached the server
+			if (pulled) {
+				_completedPulls++;
+			}
+		}
+		_pulled.notify_all();
+	}
+}
+
+void MessageReceiver::pullOnce()
+{
+	if (!_netManager.is_connected()) {
+		_netManager.connect_to_server(_host, _port);
+	}
+
+	PullMessagesRequest req(_myUUID);
+	req.setProtocolFlags(_protocolFlags);
+	_netManager.send_data(req.getPackedRequest());
+	ServerResponse res = _netManager.receive_response();
+
+	if (res.code != 2104) {
+		throw std::runtime_error("Error: Server rejected the pull request.");
+	}
+	if (res.payload.empty()) {
+		return;
+	}
+
+	std::unique_ptr<PullBatch> batch = formatBatch(res.payload, _myUUID, _registry, *_privateKey);
+	if (!_inbox.tryPush(std::move(batch))) {
+		_held = std::move(batch);
+	}
+}
+
+bool MessageReceiver::queueHeld()
+{
+	if (!_held) {
+		return true;
+	}
+	return _inbox.tryPush(std::move(_held));
+}
+
+void MessageReceiver::decodeBatch(const std::string& payload, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey,
+	const std::function<void(const DecodedMessage&)>& visit)
+{
+	PullBatch batch(payload);
+	decodeBatch(batch, myUUID, registry, privateKey, visit);
+}
+
+// a group message carries its own key, wrapped for each recipient ahead of the sealed content;
+// returns our copy and leaves content pointing past the key table
+static std::string unwrapGroupKey(std::string_view& content, const std::array<char, UUID_SIZE>& myUUID, LazyPrivateKey& privateKey)
+{
+	schema::Reader reader(content);
+	auto [count] = reader.read<GroupKeyCountLayout>();
+
+	std::string_view wrapped;
+	for (uint16_t i = 0; i < count; i++)
+	{
+		auto [recipientID, wrappedSize] = reader.read<GroupKeyEntryLayout>();
+		std::string_view entry = reader.bytes(wrappedSize);
+		if (recipientID == myUUID) {
+			wrapped = entry;
+		}
+	}
+	if (wrapped.empty()) {
+		throw std::runtime_error("Error: Group message carries no key for this client.");
+	}
+
+	content = content.substr(content.length() - reader.remaining());
+	return privateKey.decrypt(wrapped.data(), (unsigned int)wrapped.length());
+}
+
+void MessageReceiver::decodeBatch(PullBatch& batch, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey,
+	const std::function<void(const DecodedMessage&)>& visit)
+{
+	TRACE_SCOPE("pull.decrypt_format");
+
+	// one decryptor per sender for the whole batch, allocated from the batch arena
+	std::pmr::map<std::array<char, UUID_SIZE>, AESWrapper> decryptors(batch.arena());
+
+	for (const PulledMessage& msg : batch.messages())
+	{
+		std::optional<ClientData> sender = registry.findByUUID(msg.fromUUID);
+		DecodedMessage decoded{ msg.id, msg.type, (sender && !sender->username.empty()) ? sender->username : "Unknown", {}, true };
+		std::string content;
+
+		switch (msg.type)
+		{
+		case MessageType::REQUEST_SYM_KEY:
+			break;
+		case MessageType::SEND_SYM_KEY:
+			try {
+				std::string decryptedKey = privateKey.decrypt(msg.content.data(), (unsigned int)msg.content.length());
+				if (registry.storeSymmetricKey(msg.fromUUID, decryptedKey)) {
+					decryptors.erase(msg.fromUUID);
+				}
+			}
+			catch (const std::exception&) {
+				decoded.decrypted = false;
+			}
+			break;
+		case MessageType::TEXT_MESSAGE:
+		case MessageType::FILE_MESSAGE:
+			if (!msg.groupKeys && (!sender || sender->symmetricKey.empty())) {
+				decoded.decrypted = false;
+				break;
+			}
+			try {
+				std::string_view sealed = msg.content;
+				std::optional<AESWrapper> groupDecryptor;
+				AESWrapper* decryptor;
+				if (msg.groupKeys) {
+					std::string groupKey = unwrapGroupKey(sealed, myUUID, privateKey);
+					groupDecryptor.emplace(reinterpret_cast<const unsigned char*>(groupKey.c_str()), static_cast<unsigned int>(AESWrapper::DEFAULT_KEYLENGTH));
+					decryptor = &*groupDecryptor;
+				}
+				else {
+					auto it = decryptors.find(msg.fromUUID);
+					if (it == decryptors.end()) {
+						it = decryptors.try_emplace(msg.fromUUID, reinterpret_cast<const unsigned char*>(sender->symmetricKey.c_str()), static_cast<unsigned int>(AESWrapper::DEFAULT_KEYLENGTH)).first;
+					}
+					decryptor = &it->second;
+				}
+
+				char* plain = batch.allocate(sealed.length());
+				size_t plainLength = decryptor->decrypt(sealed.data(), (unsigned int)sealed.length(), plain);
+				decoded.content = std::string_view(plain, plainLength);
+				if (!msg.groupKeys && sender->symmetricKeyProposed) {
+					registry.confirmSymmetricKey(msg.fromUUID, sender->symmetricKey);
+				}
+
+				if (msg.compressed) {
+					content = CompressionWrapper::decompress(std::string(plain, plainLength));
+					decoded.content = content;
+				}
+				if (msg.type == MessageType::FILE_MESSAGE) {
+					content = saveReceivedFile(msg.fromUUID, msg.id, decoded.content);
+					decoded.content = content;
+				}
+			}
+			catch (const std::exception&) {
+				decoded.content = {};
+				decoded.decrypted = false;
+			}
+			break;
+		default:
+			break;
+		}
+
+		visit(decoded);
+	}
+}
+
+// the name carries the sender and a random suffix, and the file is created exclusively, so a
+// name guessed or reused by someone else is never written through
+std::string MessageReceiver::saveReceivedFile(const std::array<char, UUID_SIZE>& fromUUID, uint32_t messageID, std::string_view content)
+{
+	static const int MAX_ATTEMPTS = 8;
+
+	std::string prefix = "messageu_" + UUIDHelper::getHexFromUUID(std::string(fromUUID.data(), UUID_SIZE)) + "_" + std::to_string(messageID) + "_";
+	std::random_device random;
+
+	for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+	{
+		char suffix[17];
+		snprintf(suffix, sizeof(suffix), "%08x%08x", random(), random());
+		std::filesystem::path path = std::filesystem::temp_directory_path() / (prefix + suffix);
+
+		FILE* file = nullptr;
+		if (fopen_s(&file, path.string().c_str(), "wbx") != 0) {
+			if (errno == EEXIST) {
+				continue;
+			}
+			break;
+		}
+
+		bool written = fwrite(content.data(), 1, content.length(), file) == content.length();
+		if (fclose(file) != 0 || !written) {
+			std::filesystem::remove(path);
+			break;
+		}
+		return path.string();
+	}
+	throw std::runtime_error("Error: Could not save received file.");
+}
+
+std::unique_ptr<PullBatch> MessageReceiver::formatBatch(const std::string& payload, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey)
+{
+	std::unique_ptr<PullBatch> batch = std::make_unique<PullBatch>(payload);
+	std::pmr::string& output = batch->output();
+	output.reserve(payload.length() + 64);
+
+	decodeBatch(*batch, myUUID, registry, privateKey, [&output](const DecodedMessage& msg) {
+		output.append("From: ");
+		output.append(msg.sender);
+		output.append("\nContent:\n");
+
+		if (!msg.decrypted) {
+			output.append("can't decrypt message\n");
+		}
+		else if (msg.type == MessageType::REQUEST_SYM_KEY) {
+			output.append("Request for symmetric key\n");
+		}
+		else if (msg.type == MessageType::SEND_SYM_KEY) {
+			output.append("symmetric key received\n");
+		}
+		else if (msg.type == MessageType::TEXT_MESSAGE || msg.type == MessageType::FILE_MESSAGE) {
+			output.append(msg.content);
+			output.append("\n");
+		}
+		else {
+			output.append("Unknown message type received.\n");
+		}
+		output.append("-----<EOM>-----\n\n");
+	});
+
+	return batch;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "NetworkManager.h"
+#include "ClientRegistry.h"
+#include "LazyPrivateKey.h"
+#include "SpscQueue.h"
+#include "PullBatch.h"
+#include "Protocol.h"
+#include <string>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <cstdint>
+
+struct DecodedMessage {
+	uint32_t id;
+	MessageType type;
+	std::string sender;
+	std::string_view content;	// plain text, or the saved path for a file; only valid inside the visitor
+	bool decrypted;
+};
+
+// Pulls, decrypts and formats waiting messages on its own connection and thread. Each
+// non-empty batch is handed to the UI thread with its ready-to-print text in the batch arena.
+class MessageReceiver
+{
+public:
+	static const unsigned int POLL_INTERVAL_MS = 1000;
+	static const size_t QUEUE_CAPACITY = 64;
+
+	MessageReceiver(ClientRegistry& registry);
+	~MessageReceiver();
+
+	void start(const std::string& host, int port, const std::array<char, UUID_SIZE>& myUUID, LazyPrivateKey* privateKey, uint8_t protocolFlags);
+
+	void stop();
+
+	bool isRunning() const;
+
+	bool pullNow(unsigned int timeoutMs);
+
+	bool poll(std::unique_ptr<PullBatch>& batch);
+
+	// myUUID picks this client's key out of group messages
+	static void decodeBatch(const std::string& payload, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey,
+		const std::function<void(const DecodedMessage&)>& visit);
+
+	static void decodeBatch(PullBatch& batch, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey,
+		const std::function<void(const DecodedMessage&)>& visit);
+
+	// the text is in the returned batch's output()
+	static std::unique_ptr<PullBatch> formatBatch(const std::string& payload, const std::array<char, UUID_SIZE>& myUUID, ClientRegistry& registry, LazyPrivateKey& privateKey);
+
+private:
+	ClientRegistry& _registry;
+	NetworkManager _netManager;
+	std::string _host;
+	int _port;
+	std::array<char, UUID_SIZE> _myUUID;
+	LazyPrivateKey* _privateKey;
+	uint8_t _protocolFlags;
+
+	SpscQueue<std::unique_ptr<PullBatch>, QUEUE_CAPACITY> _inbox;
+	std::unique_ptr<PullBatch> _held;	// a batch that found the inbox full; nothing is pulled until it is queued
+
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	std::condition_variable _pulled;
+	bool _stopping;
+	bool _notified;
+	bool _pulling;
+	uint64_t _completedPulls;
+
+	void run();
+
+	void pullOnce();
+
+	bool queueHeld();
+
+	static std::string saveReceivedFile(const std::array<char, UUID_SIZE>& fromUUID, uint32_t messageID, std::string_view content);
+};
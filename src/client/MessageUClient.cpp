@@ -1,34 +1,30 @@
 #include "MessageUClient.h"
 #include "Request.h"       
+#include "ProtocolSchema.h"
 #include "AESWrapper.h"   
 #include "Base64Wrapper.h"  
+#include "UUIDHelper.h"
+#include "NetworkMetrics.h"
+#include "Tracer.h"
 #include <iostream>
 #include <iomanip>      
 #include <sstream>       
 #include <stdexcept>
 #include <cstring>   
 #include <limits>
-
-std::string MessageUClient::getHexFromUUID(const std::string& uuid_bytes) {
-	std::stringstream ss;
-	ss << std::hex << std::setfill('0');
-	for (unsigned char c : uuid_bytes) {
-		ss << std::setw(2) << static_cast<int>(c);
-	}
-	return ss.str();
-}
-
-std::string MessageUClient::getUUIDFromHex(const std::string& hex_string) {
-	std::string bytes;
-	if (hex_string.length() != 32) {
-		throw std::runtime_error("Invalid hex UUID string length.");
-	}
-	for (unsigned int i = 0; i < hex_string.length(); i += 2) {
-		std::string byteString = hex_string.substr(i, 2);
-		char byte = static_cast<char>(std::strtol(byteString.c_str(), NULL, 16));
-		bytes.push_back(byte);
-	}
-	return bytes;
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <map>
+#include <io.h>
+#include <conio.h>
+
+static std::string sealContent(const std::string& symKey, const std::string& plain)
+{
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(symKey.c_str()), AESWrapper::DEFAULT_KEYLENGTH);
+	return aes.encrypt(plain.c_str(), (unsigned int)plain.length());
 }
 
 void MessageUClient::clearCinBuffer()
@@ -44,19 +40,54 @@ std::string MessageUClient::getStringFromUser(const std::string& prompt)
 	return input;
 }
 
+std::vector<std::string> MessageUClient::getNamesFromUser(const std::string& prompt)
+{
+	std::vector<std::string> names;
+	std::stringstream ss(getStringFromUser(prompt));
+	std::string name;
+	while (std::getline(ss, name, ',')) {
+		size_t first = name.find_first_not_of(" \t");
+		if (first == std::string::npos) {
+			continue;
+		}
+		size_t last = name.find_last_not_of(" \t");
+		names.push_back(name.substr(first, last - first + 1));
+	}
+	return names;
+}
+
 
-MessageUClient::MessageUClient() : _myPrivateKey(nullptr), _isRegistered(false)
+MessageUClient::MessageUClient(const ClientOptions& options) : _journal(OUTBOX_JOURNAL_FILE), _outboundSender(_journal), _receiver(_registry), _options(options), _isRegistered(false)
 {
 	_myUUID.fill(0);
+	_server = ClientConfig::loadServerInfo();
+
+	// name resolution and the TCP handshake run while my.info is read; if loading throws,
+	// the future's destructor still waits for the connect before the members go away
+	std::future<void> connected = std::async(std::launch::async, [this] { connect(); });
 	loadMyInfo();
-	connect();
-	std::cout << "Client is connected to server." << std::endl;
+	connected.get();
+	console() << "Client is connected to server." << std::endl;
+
+	_outboundSender.setCompletionHandler([this](const std::string& packedRequest, const ServerResponse& response, bool awaited) {
+		onSendCompleted(packedRequest, response, awaited);
+	});
+	_outboundSender.start(_server.first, _server.second);
+	if (_journal.pendingCount() > 0) {
+		console() << _journal.pendingCount() << " queued message(s) will be delivered in the background." << std::endl;
+		_outboundSender.notify();
+	}
+	startReceiver();
 }
 
 MessageUClient::~MessageUClient()
 {
-	delete _myPrivateKey;
+	_receiver.stop();
+	_outboundSender.stop();
 	_netManager.disconnect_server();
+
+	// the server has already deleted whatever the receiver pulled
+	printIncoming();
 }
 
 
@@ -65,14 +96,14 @@ void MessageUClient::loadMyInfo()
 	if (ClientConfig::myInfoExists())
 	{
 		_myInfo = ClientConfig::loadMyInfo();
-		std::string rawUUID = getUUIDFromHex(_myInfo.uuid);
+		std::string rawUUID = UUIDHelper::getUUIDFromHex(_myInfo.uuid);
 		memcpy(_myUUID.data(), rawUUID.data(), UUID_SIZE);
 
-		std::string rawPrivateKey = Base64Wrapper::decode(_myInfo.privateKeyBase64);
-		_myPrivateKey = new RSAPrivateWrapper(rawPrivateKey);
+		// parsed on the first SEND_SYM_KEY to decrypt
+		_myPrivateKey = std::make_unique<LazyPrivateKey>(_myInfo.privateKeyBase64);
 
 		_isRegistered = true;
-		std::cout << "Logged in as: " << _myInfo.username << std::endl;
+		console() << "Logged in as: " << _myInfo.username << std::endl;
 	}
 	else
 	{
@@ -80,10 +111,113 @@ void MessageUClient::loadMyInfo()
 	}
 }
 
+void MessageUClient::startReceiver()
+{
+	if (!_isRegistered || !_options.backgroundReceive || _receiver.isRunning()) {
+		return;
+	}
+	_receiver.start(_server.first, _server.second, _myUUID, _myPrivateKey.get(), protocolFlags());
+}
+
+bool MessageUClient::printIncoming()
+{
+	bool printed = false;
+	{
+		std::lock_guard<std::mutex> lock(_rejectionsMutex);
+		for (const std::string& rejection : _rejections) {
+			console() << rejection << std::endl;
+			printed = true;
+		}
+		_rejections.clear();
+	}
+
+	std::unique_ptr<PullBatch> batch;
+	while (_receiver.poll(batch)) {
+		std::cout.write(batch->output().data(), batch->output().length());
+		printed = true;
+	}
+	std::cout.flush();
+	return printed;
+}
+
+void MessageUClient::waitForInput()
+{
+	// only an interactive console can be polled without consuming input
+	if (!_receiver.isRunning() || !_isatty(_fileno(stdin))) {
+		return;
+	}
+	while (!_kbhit()) {
+		if (printIncoming()) {
+			std::cout << "? " << std::flush;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_POLL_MS));
+	}
+}
+
 void MessageUClient::connect()
 {
-	std::pair<std::string, int> server = ClientConfig::loadServerInfo();
-	_netManager.connect_to_server(server.first, server.second);
+	_netManager.connect_to_server(_server.first, _server.second);
+}
+
+void MessageUClient::reconnect()
+{
+	connect();
+	_outboundSender.notify();
+}
+
+bool MessageUClient::waitForDelivery()
+{
+	return _outboundSender.waitUntilIdle(DELIVERY_TIMEOUT_MS);
+}
+
+std::ostream& MessageUClient::console() const
+{
+	// batch mode keeps stdout for its results
+	return _options.batchFile.empty() ? std::cout : std::cerr;
+}
+
+void MessageUClient::requireRegistered() const
+{
+	if (!_isRegistered || !_myPrivateKey) {
+		throw OperationError("Error: You must be registered to perform this action.");
+	}
+}
+
+void MessageUClient::onSendCompleted(const std::string& packedRequest, const ServerResponse& response, bool awaited)
+{
+	schema::Reader reader(packedRequest);
+	auto [clientID, version, code, payloadSize] = reader.read<RequestHeaderLayout>();
+	if (code != static_cast<uint16_t>(RequestCode::SEND_MESSAGE)) {
+		return;
+	}
+	auto [targetID, type, contentSize] = reader.read<SendMessagePayloadLayout>();
+
+	bool accepted = (response.code == 2103);
+	if (static_cast<MessageType>(type) == MessageType::SEND_SYM_KEY) {
+		_registry.settleSymmetricKey(targetID, accepted);
+	}
+	if (accepted || awaited) {
+		return;
+	}
+
+	std::optional<ClientData> target = _registry.findByUUID(targetID);
+	std::string recipient = (target && !target->username.empty()) ? target->username : UUIDHelper::getHexFromUUID(std::string(targetID.data(), UUID_SIZE));
+	std::string what = (static_cast<MessageType>(type) == MessageType::SEND_SYM_KEY) ? "Symmetric key" : "Queued message";
+
+	std::lock_guard<std::mutex> lock(_rejectionsMutex);
+	_rejections.push_back("Error: " + what + " for " + recipient + " was rejected by the server.");
+}
+
+void MessageUClient::queueMessage(const std::array<char, UUID_SIZE>& targetID, MessageType type, const std::string& content)
+{
+	SendMessageRequest req(_myUUID, targetID, type, content);
+	_journal.append(req.getPackedRequest());
+	_outboundSender.notify();
+}
+
+uint8_t MessageUClient::protocolFlags() const
+{
+	return _options.compression ? PROTOCOL_FLAG_COMPRESSION : 0;
 }
 
 void MessageUClient::displayMenu()
@@ -96,12 +230,18 @@ void MessageUClient::displayMenu()
 	std::cout << "150) Send a text message" << std::endl;
 	std::cout << "151) Send a request for symmetric key" << std::endl;
 	std::cout << "152) Send your symmetric key" << std::endl;
+	std::cout << "153) Send a text message to multiple clients" << std::endl;
+	std::cout << "154) Send a request for symmetric key to multiple clients" << std::endl;
+	std::cout << "155) Send a text message to a group (one-time key, one upload)" << std::endl;
+	std::cout << "160) Show network statistics" << std::endl;
 	std::cout << "0) Exit client" << std::endl;
 	std::cout << "? ";
 }
 
 int MessageUClient::getUserSelection()
 {
+	waitForInput();
+
 	int selection = -1;
 	if (!(std::cin >> selection))
 	{
@@ -117,6 +257,7 @@ void MessageUClient::run()
 {
 	while (true)
 	{
+		printIncoming();
 		displayMenu();
 		int selection = getUserSelection();
 
@@ -130,7 +271,15 @@ void MessageUClient::run()
 			case 150: handleSendText(); break;
 			case 151: handleRequestSymKey(); break;
 			case 152: handleSendSymKey(); break;
+			case 153: handleSendTextToMany(); break;
+			case 154: handleRequestSymKeyFromMany(); break;
+			case 155: handleSendTextToGroup(); break;
+			case 160: handleNetworkStats(); break;
 			case 0:
+				if (!waitForDelivery()) {
+					std::cout << _journal.pendingCount() << " queued message(s) will be delivered on the next start." << std::endl;
+				}
+				printIncoming();
 				std::cout << "Exiting. Goodbye!" << std::endl;
 				return;
 			default:
@@ -138,26 +287,27 @@ void MessageUClient::run()
 				break;
 			}
 		}
+		catch (const OperationError& e) {
+			std::cout << e.what() << std::endl;
+		}
 		catch (const std::exception& e) {
 			std::cerr << "An error occurred: " << e.what() << std::endl;
-			try { connect(); }
+			try {
+				reconnect();
+			}
 			catch (...) { std::cerr << "Failed to reconnect." << std::endl; }
 		}
 	}
 }
 
 
-void MessageUClient::handleRegister()
+std::string MessageUClient::registerClient(const std::string& name)
 {
 	if (_isRegistered) {
-		std::cout << "Error: You are already registered." << std::endl;
-		return;
+		throw OperationError("Error: You are already registered.");
 	}
-
-	std::string name = getStringFromUser("Enter username: ");
-	if (name.length() >= CLIENT_NAME_SIZE) {
-		std::cout << "Error: Username is too long." << std::endl;
-		return;
+	if (name.empty() || name.length() >= CLIENT_NAME_SIZE) {
+		throw OperationError("Error: Username is empty or too long.");
 	}
 
 	RSAPrivateWrapper newKeys;
@@ -168,80 +318,122 @@ void MessageUClient::handleRegister()
 	_netManager.send_data(req.getPackedRequest());
 	ServerResponse res = _netManager.receive_response();
 
-	if (res.code == 2100) {
-		std::string uuid_bytes = res.payload;
-		std::string uuid_hex = getHexFromUUID(uuid_bytes);
-		std::string privKeyRaw = newKeys.getPrivateKey();
-		std::string privKey64 = Base64Wrapper::encode(privKeyRaw);
-
-		ClientConfig::saveMyInfo(name, uuid_hex, privKey64);
-		loadMyInfo();
-		std::cout << "Registered successfully. Your UUID is: " << uuid_hex << std::endl;
-	}
-	else {
-		std::cout << "server responded with an error" << std::endl;
+	if (res.code != 2100) {
+		throw OperationError("server responded with an error");
 	}
+
+	schema::Reader reader(res.payload);
+	auto [uuid] = reader.read<RegisterSuccessLayout>();
+	std::string uuid_hex = UUIDHelper::getHexFromUUID(std::string(uuid.data(), UUID_SIZE));
+	std::string privKeyRaw = newKeys.getPrivateKey();
+	std::string privKey64 = Base64Wrapper::encode(privKeyRaw);
+
+	ClientConfig::saveMyInfo(name, uuid_hex, privKey64);
+	loadMyInfo();
+	startReceiver();
+	return uuid_hex;
 }
 
-void MessageUClient::handleClientList()
+void MessageUClient::handleRegister()
 {
-	if (!_isRegistered) {
-		std::cout << "Error: You must be registered to perform this action." << std::endl;
+	if (_isRegistered) {
+		std::cout << "Error: You are already registered." << std::endl;
 		return;
 	}
 
+	std::string name = getStringFromUser("Enter username: ");
+	std::string uuid_hex = registerClient(name);
+	std::cout << "Registered successfully. Your UUID is: " << uuid_hex << std::endl;
+}
+
+std::vector<std::string> MessageUClient::requestClientList()
+{
+	requireRegistered();
+
 	ClientListRequest req(_myUUID);
+	req.setProtocolFlags(protocolFlags());
 	_netManager.send_data(req.getPackedRequest());
 	ServerResponse res = _netManager.receive_response();
 
-	if (res.code == 2101) {
-		std::cout << "Client List:" << std::endl;
-		std::string payload = res.payload;
-		const size_t recordSize = UUID_SIZE + CLIENT_NAME_SIZE;
+	if (res.code != 2101) {
+		throw OperationError("server responded with an error");
+	}
 
-		for (size_t i = 0; i < payload.length(); i += recordSize) {
-			std::string uuid_bytes = payload.substr(i, UUID_SIZE);
-			std::string name_bytes = payload.substr(i + UUID_SIZE, CLIENT_NAME_SIZE);
+	std::vector<std::string> names;
+	schema::Reader reader(res.payload);
+	while (!reader.empty()) {
+		auto [uuid, name] = reader.read<ClientListRecordLayout>();
+		std::string name_str = schema::unpadded(name);
 
-			std::string name_str(name_bytes.c_str());
+		_registry.registerClient(uuid, name_str);
+		names.push_back(std::move(name_str));
+	}
+	return names;
+}
 
-			std::array<char, UUID_SIZE> uuid_arr;
-			memcpy(uuid_arr.data(), uuid_bytes.data(), UUID_SIZE);
+void MessageUClient::handleClientList()
+{
+	std::vector<std::string> names = requestClientList();
+	std::cout << "Client List:" << std::endl;
+	for (const std::string& name : names) {
+		std::cout << "- " << name << std::endl;
+	}
+}
+
+std::vector<SendResult> MessageUClient::fetchPublicKeys(const std::vector<std::string>& names)
+{
+	requireRegistered();
 
-			_registry.registerClient(uuid_arr, name_str);
-			std::cout << "- " << name_str << std::endl;
+	std::vector<SendResult> results;
+	std::vector<std::pair<size_t, std::array<char, UUID_SIZE>>> requested;
+	std::string pipeline;
+
+	for (const std::string& name : names)
+	{
+		std::optional<ClientData> target = _registry.findByName(name);
+		if (!target) {
+			results.push_back({ name, false, "client not found" });
+			continue;
 		}
+		results.push_back({ name, false, "rejected by server" });
+		requested.emplace_back(results.size() - 1, target->uuid);
+
+		PublicKeyRequest req(_myUUID, target->uuid);
+		pipeline.append(req.getPackedRequest());
 	}
-	else {
-		std::cout << "server responded with an error" << std::endl;
+
+	if (requested.empty()) {
+		return results;
 	}
+
+	// all lookups go out in one write; the server answers them in order
+	_netManager.send_data(pipeline);
+	for (const auto& [index, uuid] : requested)
+	{
+		ServerResponse res = _netManager.receive_response();
+		if (res.code != 2102) {
+			continue;
+		}
+		schema::Reader reader(res.payload);
+		auto [keyOwner, key] = reader.read<PublicKeyResponseLayout>();
+		_registry.setPublicKey(uuid, std::string(key.data(), key.size()));
+		results[index].delivered = true;
+		results[index].status = "public key received";
+	}
+	return results;
 }
 
 void MessageUClient::handlePublicKey()
 {
-	if (!_isRegistered) {
-		std::cout << "Error: You must be registered to perform this action." << std::endl;
-		return;
-	}
+	requireRegistered();
 
 	std::string name = getStringFromUser("Enter client name: ");
-	ClientData* target = _registry.findByName(name);
-	if (!target) {
-		std::cout << "Error: Client not found. Please request client list first." << std::endl;
-		return;
-	}
-
-	PublicKeyRequest req(_myUUID, target->uuid);
-	_netManager.send_data(req.getPackedRequest());
-	ServerResponse res = _netManager.receive_response();
-
-	if (res.code == 2102) {
-		std::string pubKey = res.payload.substr(UUID_SIZE);
-		_registry.setPublicKey(target->uuid, pubKey);
+	SendResult result = fetchPublicKeys({ name }).front();
+	if (result.delivered) {
 		std::cout << "Successfully received public key for " << name << std::endl;
 	}
 	else {
-		std::cout << "server responded with an error" << std::endl;
+		std::cout << "Error: " << result.status << std::endl;
 	}
 }
 
@@ -253,7 +445,7 @@ void MessageUClient::handleSendSymKey()
 	}
 
 	std::string name = getStringFromUser("Enter client name: ");
-	ClientData* target = _registry.findByName(name);
+	std::optional<ClientData> target = _registry.findByName(name);
 	if (!target) {
 		std::cout << "Error: Client not found. Please request client list first." << std::endl;
 		return;
@@ -270,17 +462,10 @@ void MessageUClient::handleSendSymKey()
 	RSAPublicWrapper rsaPub(target->publicKey);
 	std::string encryptedKey = rsaPub.encrypt(symKey);
 
-	SendMessageRequest req(_myUUID, target->uuid, MessageType::SEND_SYM_KEY, encryptedKey);
-	_netManager.send_data(req.getPackedRequest());
-	ServerResponse res = _netManager.receive_response();
-
-	if (res.code == 2103) {
-		_registry.setSymmetricKey(target->uuid, symKey);
-		std::cout << "Symmetric key sent to " << name << std::endl;
-	}
-	else {
-		std::cout << "server responded with an error" << std::endl;
-	}
+	// proposed before queuing so a fast rejection finds the key to drop
+	_registry.proposeSymmetricKey(target->uuid, symKey);
+	queueMessage(target->uuid, MessageType::SEND_SYM_KEY, encryptedKey);
+	std::cout << "Symmetric key queued for " << name << std::endl;
 }
 
 void MessageUClient::handleRequestSymKey()
@@ -291,139 +476,484 @@ void MessageUClient::handleRequestSymKey()
 	}
 
 	std::string name = getStringFromUser("Enter client name: ");
-	ClientData* target = _registry.findByName(name);
+	std::optional<ClientData> target = _registry.findByName(name);
 	if (!target) {
 		std::cout << "Error: Client not found. Please request client list first." << std::endl;
 		return;
 	}
 
-	SendMessageRequest req(_myUUID, target->uuid, MessageType::REQUEST_SYM_KEY, "");
-	_netManager.send_data(req.getPackedRequest());
-	ServerResponse res = _netManager.receive_response();
+	queueMessage(target->uuid, MessageType::REQUEST_SYM_KEY, "");
+	std::cout << "Request for symmetric key queued for " << name << std::endl;
+}
+
+void MessageUClient::handleSendText()
+{
+	requireRegistered();
+
+	std::string name = getStringFromUser("Enter client name: ");
+	std::string text = getStringFromUser("Enter message: ");
 
-	if (res.code == 2103) {
-		std::cout << "Request for symmetric key sent to " << name << std::endl;
+	SendResult result = sendWithKeyExchange({ { name, MessageType::TEXT_MESSAGE, std::make_shared<const std::string>(text) } }).front();
+	if (result.delivered) {
+		std::cout << "Message delivered." << std::endl;
+	}
+	else if (result.status == "queued") {
+		std::cout << "Message queued." << std::endl;
 	}
 	else {
-		std::cout << "server responded with an error" << std::endl;
+		std::cout << "Error: " << result.status << std::endl;
 	}
 }
 
-void MessageUClient::handleSendText()
+std::vector<SendResult> MessageUClient::sendMessages(const std::vector<OutgoingMessage>& messages)
+{
+	requireRegistered();
+
+	std::vector<SendResult> results;
+	std::vector<size_t> sendable;
+	std::vector<std::future<std::string>> packed;
+
+	for (const OutgoingMessage& message : messages)
+	{
+		results.push_back({ message.recipient, false, "" });
+
+		std::optional<ClientData> target = _registry.findByName(message.recipient);
+		if (!target) {
+			results.back().status = "client not found";
+			continue;
+		}
+
+		std::array<char, UUID_SIZE> myUUID = _myUUID;
+		std::array<char, UUID_SIZE> targetUUID = target->uuid;
+		MessageType type = message.type;
+
+		if (type == MessageType::REQUEST_SYM_KEY) {
+			packed.push_back(_workerPool.submit([myUUID, targetUUID] {
+				return SendMessageRequest(myUUID, targetUUID, MessageType::REQUEST_SYM_KEY, "").getPackedRequest();
+			}));
+		}
+		else if (type == MessageType::SEND_SYM_KEY) {
+			if (target->publicKey.empty()) {
+				results.back().status = "public key unknown";
+				continue;
+			}
+
+			// set now so text queued behind it in the same batch is sealed with the new key;
+			// it stays proposed until the server answers and is dropped if the server refuses it
+			unsigned char key_bytes[AESWrapper::DEFAULT_KEYLENGTH];
+			AESWrapper::GenerateKey(key_bytes, AESWrapper::DEFAULT_KEYLENGTH);
+			std::string symKey(reinterpret_cast<char*>(key_bytes), AESWrapper::DEFAULT_KEYLENGTH);
+			_registry.proposeSymmetricKey(targetUUID, symKey);
+
+			std::string publicKey = target->publicKey;
+			packed.push_back(_workerPool.submit([myUUID, targetUUID, publicKey, symKey] {
+				RSAPublicWrapper rsaPub(publicKey);
+				return SendMessageRequest(myUUID, targetUUID, MessageType::SEND_SYM_KEY, rsaPub.encrypt(symKey)).getPackedRequest();
+			}));
+		}
+		else {
+			if (target->symmetricKey.empty()) {
+				results.back().status = "symmetric key unknown";
+				continue;
+			}
+
+			std::string symKey = target->symmetricKey;
+			std::shared_ptr<const std::string> plain = message.content;
+			packed.push_back(_workerPool.submit([myUUID, targetUUID, symKey, plain, type] {
+				SendMessageRequest req(myUUID, targetUUID, type, sealContent(symKey, *plain));
+				return req.getPackedRequest();
+			}));
+		}
+		sendable.push_back(results.size() - 1);
+	}
+
+	if (sendable.empty()) {
+		return results;
+	}
+
+	std::vector<std::string> requests;
+	requests.reserve(packed.size());
+	for (std::future<std::string>& request : packed) {
+		requests.push_back(request.get());
+	}
+
+	std::vector<std::future<ServerResponse>> responses = _outboundSender.submit(requests);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DELIVERY_TIMEOUT_MS);
+	for (size_t i = 0; i < responses.size(); i++)
+	{
+		SendResult& result = results[sendable[i]];
+		if (responses[i].wait_until(deadline) != std::future_status::ready) {
+			result.status = "queued";
+			continue;
+		}
+
+		try {
+			result.delivered = (responses[i].get().code == 2103);
+			result.status = result.delivered ? "delivered" : "rejected by server";
+		}
+		catch (const std::future_error&) {
+			result.status = "queued";
+		}
+	}
+
+	return results;
+}
+
+std::vector<SendResult> MessageUClient::sendWithKeyExchange(const std::vector<OutgoingMessage>& messages)
+{
+	requireRegistered();
+
+	auto needsKey = [](const OutgoingMessage& message) {
+		return message.type == MessageType::TEXT_MESSAGE || message.type == MessageType::FILE_MESSAGE;
+	};
+
+	// each stage needs the previous one's answer (list -> uuid -> public key), so a stage only
+	// runs for what is still missing, and runs once for all recipients
+	std::vector<std::string> missingPublicKeys;
+	bool listed = false;
+	for (const OutgoingMessage& message : messages)
+	{
+		if (!needsKey(message)) {
+			continue;
+		}
+		std::optional<ClientData> target = _registry.findByName(message.recipient);
+		if (!target && !listed) {
+			requestClientList();
+			listed = true;
+			target = _registry.findByName(message.recipient);
+		}
+		if (target && target->symmetricKey.empty() && target->publicKey.empty()
+			&& std::find(missingPublicKeys.begin(), missingPublicKeys.end(), message.recipient) == missingPublicKeys.end()) {
+			missingPublicKeys.push_back(message.recipient);
+		}
+	}
+	if (!missingPublicKeys.empty()) {
+		fetchPublicKeys(missingPublicKeys);
+	}
+
+	// the new keys go out in the same batch as the messages, ahead of them, so the server
+	// stores each key before the first message sealed with it
+	std::vector<OutgoingMessage> expanded;
+	std::vector<size_t> originalIndex;
+	std::map<std::string, size_t> keyIndex;
+	for (const OutgoingMessage& message : messages)
+	{
+		if (needsKey(message) && !keyIndex.count(message.recipient)) {
+			std::optional<ClientData> target = _registry.findByName(message.recipient);
+			if (target && target->symmetricKey.empty()) {
+				keyIndex[message.recipient] = expanded.size();
+				expanded.push_back({ message.recipient, MessageType::SEND_SYM_KEY, nullptr });
+			}
+		}
+		originalIndex.push_back(expanded.size());
+		expanded.push_back(message);
+	}
+
+	std::vector<SendResult> sent = sendMessages(expanded);
+
+	std::vector<SendResult> results;
+	results.reserve(messages.size());
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		SendResult result = sent[originalIndex[i]];
+		auto key = keyIndex.find(messages[i].recipient);
+		if (needsKey(messages[i]) && key != keyIndex.end() && !sent[key->second].delivered && !result.delivered) {
+			result.status = "key exchange failed: " + sent[key->second].status;
+		}
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+std::vector<SendResult> MessageUClient::sendTextToMany(const std::vector<std::string>& names, const std::string& text)
+{
+	std::shared_ptr<const std::string> plain = std::make_shared<const std::string>(text);
+	std::vector<OutgoingMessage> messages;
+	messages.reserve(names.size());
+	for (const std::string& name : names) {
+		messages.push_back({ name, MessageType::TEXT_MESSAGE, plain });
+	}
+	return sendWithKeyExchange(messages);
+}
+
+void MessageUClient::handleSendTextToMany()
 {
 	if (!_isRegistered) {
 		std::cout << "Error: You must be registered." << std::endl;
 		return;
 	}
 
-	std::string name = getStringFromUser("Enter client name: ");
-	ClientData* target = _registry.findByName(name);
-	if (!target) {
-		std::cout << "Error: Client not found. Please request client list first." << std::endl;
-		return;
-	}
-	if (target->symmetricKey.empty()) {
-		std::cout << "Error: Symmetric key for " << name << " is unknown. Please send one first (152)." << std::endl;
+	std::vector<std::string> names = getNamesFromUser("Enter client names (comma separated): ");
+	if (names.empty()) {
+		std::cout << "Error: No client names given." << std::endl;
 		return;
 	}
 
 	std::string text = getStringFromUser("Enter message: ");
 
-	AESWrapper aes(reinterpret_cast<const unsigned char*>(target->symmetricKey.c_str()), AESWrapper::DEFAULT_KEYLENGTH);
-	std::string cipher = aes.encrypt(text.c_str(), (unsigned int)text.length());
+	std::vector<SendResult> results = sendTextToMany(names, text);
+	for (const SendResult& result : results) {
+		std::cout << "- " << result.recipient << ": " << result.status << std::endl;
+	}
+}
 
-	SendMessageRequest req(_myUUID, target->uuid, MessageType::TEXT_MESSAGE, cipher);
-	_netManager.send_data(req.getPackedRequest());
-	ServerResponse res = _netManager.receive_response();
+std::vector<SendResult> MessageUClient::sendSharedMessage(const std::vector<std::string>& names, MessageType type, const std::string& content)
+{
+	std::vector<SendResult> results;
+	std::vector<std::array<char, UUID_SIZE>> targetIDs;
+	std::map<std::array<char, UUID_SIZE>, size_t> resultIndex;
 
-	if (res.code == 2103) {
-		std::cout << "Message sent." << std::endl;
+	for (const std::string& name : names)
+	{
+		std::optional<ClientData> target = _registry.findByName(name);
+		if (!target) {
+			results.push_back({ name, false, "client not found" });
+			continue;
+		}
+		results.push_back({ name, false, "" });
+		targetIDs.push_back(target->uuid);
+		resultIndex[target->uuid] = results.size() - 1;
 	}
-	else {
-		std::cout << "server responded with an error" << std::endl;
+
+	if (targetIDs.empty()) {
+		return results;
 	}
+
+	SendMultiMessageRequest req(_myUUID, targetIDs, type, content);
+	std::future<ServerResponse> response = std::move(_outboundSender.submit({ req.getPackedRequest() }).front());
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DELIVERY_TIMEOUT_MS);
+	markStored(response, deadline, resultIndex, results);
+	return results;
 }
 
-void MessageUClient::handlePullMessages()
+std::vector<SendResult> MessageUClient::sendToGroup(const std::vector<std::string>& names, MessageType type, std::shared_ptr<const std::string> content)
 {
-	if (!_isRegistered || !_myPrivateKey) {
-		std::cout << "Error: You must be registered to perform this action." << std::endl;
+	requireRegistered();
+
+	std::vector<std::string> missingPublicKeys;
+	bool listed = false;
+	for (const std::string& name : names)
+	{
+		std::optional<ClientData> target = _registry.findByName(name);
+		if (!target && !listed) {
+			requestClientList();
+			listed = true;
+			target = _registry.findByName(name);
+		}
+		if (target && target->publicKey.empty()
+			&& std::find(missingPublicKeys.begin(), missingPublicKeys.end(), name) == missingPublicKeys.end()) {
+			missingPublicKeys.push_back(name);
+		}
+	}
+	if (!missingPublicKeys.empty()) {
+		fetchPublicKeys(missingPublicKeys);
+	}
+
+	// a fresh key for this message only, wrapped in each recipient's public key in front of the
+	// content; it never replaces a pairwise key, so later 1:1 messages stay private to each pair
+	unsigned char key_bytes[AESWrapper::DEFAULT_KEYLENGTH];
+	AESWrapper::GenerateKey(key_bytes, AESWrapper::DEFAULT_KEYLENGTH);
+	std::string groupKey(reinterpret_cast<char*>(key_bytes), AESWrapper::DEFAULT_KEYLENGTH);
+
+	std::future<std::string> sealed = _workerPool.submit([groupKey, content] {
+		return sealContent(groupKey, *content);
+	});
+
+	std::vector<SendResult> results;
+	std::vector<std::array<char, UUID_SIZE>> targetIDs;
+	std::map<std::array<char, UUID_SIZE>, size_t> resultIndex;
+	std::vector<std::future<std::string>> wrapped;
+
+	for (const std::string& name : names)
+	{
+		results.push_back({ name, false, "" });
+
+		std::optional<ClientData> target = _registry.findByName(name);
+		if (!target) {
+			results.back().status = "client not found";
+			continue;
+		}
+		if (target->publicKey.empty()) {
+			results.back().status = "public key unknown";
+			continue;
+		}
+		if (resultIndex.count(target->uuid)) {
+			results.back().status = "duplicate recipient";
+			continue;
+		}
+
+		std::string publicKey = target->publicKey;
+		wrapped.push_back(_workerPool.submit([publicKey, groupKey] {
+			RSAPublicWrapper rsaPub(publicKey);
+			return rsaPub.encrypt(groupKey);
+		}));
+		targetIDs.push_back(target->uuid);
+		resultIndex[target->uuid] = results.size() - 1;
+	}
+
+	if (targetIDs.empty()) {
+		sealed.wait();
+		return results;
+	}
+
+	std::string body;
+	char count[GroupKeyCountLayout::size];
+	GroupKeyCountLayout::encode(count, static_cast<uint16_t>(targetIDs.size()));
+	body.append(count, sizeof(count));
+	for (size_t i = 0; i < targetIDs.size(); i++)
+	{
+		std::string key = wrapped[i].get();
+		char entry[GroupKeyEntryLayout::size];
+		GroupKeyEntryLayout::encode(entry, targetIDs[i], static_cast<uint16_t>(key.length()));
+		body.append(entry, sizeof(entry));
+		body.append(key);
+	}
+	body.append(sealed.get());
+
+	MessageType flagged = static_cast<MessageType>(static_cast<uint8_t>(type) | MESSAGE_FLAG_GROUP_KEYS);
+	SendMultiMessageRequest req(_myUUID, targetIDs, flagged, body);
+	std::future<ServerResponse> response = std::move(_outboundSender.submit({ req.getPackedRequest() }).front());
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DELIVERY_TIMEOUT_MS);
+	markStored(response, deadline, resultIndex, results);
+	return results;
+}
+
+void MessageUClient::markStored(std::future<ServerResponse>& response, std::chrono::steady_clock::time_point deadline,
+	const std::map<std::array<char, UUID_SIZE>, size_t>& resultIndex, std::vector<SendResult>& results)
+{
+	ServerResponse res = {};
+	bool answered = (response.wait_until(deadline) == std::future_status::ready);
+	if (answered) {
+		try {
+			res = response.get();
+		}
+		catch (const std::future_error&) {
+			answered = false;
+		}
+	}
+
+	for (const auto& entry : resultIndex) {
+		results[entry.second].status = answered ? "rejected by server" : "queued";
+	}
+	if (!answered || res.code != 2105) {
 		return;
 	}
 
-	PullMessagesRequest req(_myUUID);
-	_netManager.send_data(req.getPackedRequest());
-	ServerResponse res = _netManager.receive_response();
+	// the response lists (uuid, message id) for every mailbox the message was stored in
+	schema::Reader reader(res.payload);
+	while (!reader.empty())
+	{
+		auto [storedID, messageID] = reader.read<MessageStoredLayout>();
 
-	if (res.code != 2104) {
-		std::cout << "server responded with an error" << std::endl;
+		auto it = resultIndex.find(storedID);
+		if (it != resultIndex.end()) {
+			results[it->second].delivered = true;
+			results[it->second].status = "delivered";
+		}
+	}
+}
+
+void MessageUClient::handleSendTextToGroup()
+{
+	if (!_isRegistered) {
+		std::cout << "Error: You must be registered." << std::endl;
 		return;
 	}
-	if (res.payload.empty()) {
-		std::cout << "No new messages." << std::endl;
+
+	std::vector<std::string> names = getNamesFromUser("Enter client names (comma separated): ");
+	if (names.empty()) {
+		std::cout << "Error: No client names given." << std::endl;
 		return;
 	}
 
-	size_t offset = 0;
-	std::string payload = res.payload;
+	std::string text = getStringFromUser("Enter message: ");
 
-	while (offset < payload.length())
-	{
-		std::array<char, UUID_SIZE> fromUUID;
-		memcpy(fromUUID.data(), &payload[offset], UUID_SIZE);
-		offset += UUID_SIZE;
+	std::vector<SendResult> results = sendToGroup(names, MessageType::TEXT_MESSAGE, std::make_shared<const std::string>(text));
+	for (const SendResult& result : results) {
+		std::cout << "- " << result.recipient << ": " << result.status << std::endl;
+	}
+}
 
-		uint32_t msgID = *reinterpret_cast<uint32_t*>(&payload[offset]);
-		offset += sizeof(uint32_t);
+void MessageUClient::handleRequestSymKeyFromMany()
+{
+	if (!_isRegistered) {
+		std::cout << "Error: You must be registered." << std::endl;
+		return;
+	}
 
-		MessageType msgType = static_cast<MessageType>(payload[offset]);
-		offset += sizeof(uint8_t);
+	std::vector<std::string> names = getNamesFromUser("Enter client names (comma separated): ");
+	if (names.empty()) {
+		std::cout << "Error: No client names given." << std::endl;
+		return;
+	}
 
-		uint32_t contentSize = *reinterpret_cast<uint32_t*>(&payload[offset]);
-		offset += sizeof(uint32_t);
+	std::vector<SendResult> results = sendSharedMessage(names, MessageType::REQUEST_SYM_KEY, "");
+	for (const SendResult& result : results) {
+		std::cout << "- " << result.recipient << ": " << result.status << std::endl;
+	}
+}
 
-		std::string content = payload.substr(offset, contentSize);
-		offset += contentSize;
+std::string MessageUClient::pullPayload()
+{
+	PullMessagesRequest req(_myUUID);
+	req.setProtocolFlags(protocolFlags());
+	_netManager.send_data(req.getPackedRequest());
+	ServerResponse res = _netManager.receive_response();
 
-		ClientData* sender = _registry.findByUUID(fromUUID);
-		std::string senderName = sender ? sender->username : "Unknown";
+	if (res.code != 2104) {
+		throw OperationError("server responded with an error");
+	}
+	return res.payload;
+}
 
-		std::cout << "From: " << senderName << std::endl;
-		std::cout << "Content:" << std::endl;
+void MessageUClient::pullMessages(const std::function<void(const DecodedMessage&)>& visit)
+{
+	requireRegistered();
+	MessageReceiver::decodeBatch(pullPayload(), _myUUID, _registry, *_myPrivateKey, visit);
+}
 
-		switch (msgType)
-		{
-		case MessageType::REQUEST_SYM_KEY:
-			std::cout << "Request for symmetric key" << std::endl;
-			break;
-		case MessageType::SEND_SYM_KEY:
-			try {
-				std::string decryptedKey = _myPrivateKey->decrypt(content);
-				_registry.setSymmetricKey(fromUUID, decryptedKey);
-				std::cout << "symmetric key received" << std::endl;
-			}
-			catch (const std::exception&) {
-				std::cout << "can't decrypt message" << std::endl;
-			}
-			break;
-		case MessageType::TEXT_MESSAGE:
-			if (sender && !sender->symmetricKey.empty()) {
-				try {
-					AESWrapper aes(reinterpret_cast<const unsigned char*>(sender->symmetricKey.c_str()), AESWrapper::DEFAULT_KEYLENGTH);
-					std::string plain = aes.decrypt(content.c_str(), (unsigned int)content.length());
-					std::cout << plain << std::endl;
-				}
-				catch (const std::exception&) {
-					std::cout << "can't decrypt message" << std::endl;
-				}
-			}
-			else {
-				std::cout << "can't decrypt message" << std::endl;
-			}
-			break;
-		default:
-			std::cout << "Unknown message type received." << std::endl;
+void MessageUClient::handlePullMessages()
+{
+	TRACE_SCOPE("pull.handle");
+	requireRegistered();
+
+	if (_receiver.isRunning()) {
+		// the receiver skips pulls while its inbox is full, so drain it before asking for more
+		bool printed = printIncoming();
+		if (!_receiver.pullNow(RECEIVE_TIMEOUT_MS)) {
+			std::cout << "server responded with an error" << std::endl;
 		}
-		std::cout << "-----<EOM>-----" << std::endl << std::endl;
+		printed = printIncoming() || printed;
+		if (!printed) {
+			std::cout << "No new messages." << std::endl;
+		}
+		return;
+	}
+
+	std::string payload = pullPayload();
+	if (payload.empty()) {
+		std::cout << "No new messages." << std::endl;
+		return;
+	}
+
+	std::unique_ptr<PullBatch> batch = MessageReceiver::formatBatch(payload, _myUUID, _registry, *_myPrivateKey);
+	std::cout.write(batch->output().data(), batch->output().length());
+	std::cout.flush();
+}
+
+void MessageUClient::handleNetworkStats()
+{
+	std::string format = getStringFromUser("Format (json/prometheus): ");
+	if (format == "prometheus") {
+		std::cout << NetworkMetrics::instance().toPrometheus();
+	}
+	else if (format.empty() || format == "json") {
+		std::cout << NetworkMetrics::instance().toJson() << std::endl;
+	}
+	else {
+		std::cout << "Error: Unknown format." << std::endl;
 	}
 }
\ No newline at end of file
@@ -3,49 +3,141 @@
 #include "NetworkManager.h"
 #include "ClientConfig.h"
 #include "ClientRegistry.h"
-#include "RSAWrapper.h"
+#include "OutboundJournal.h"
+#include "OutboundSender.h"
+#include "MessageReceiver.h"
+#include "WorkerPool.h"
+#include "LazyPrivateKey.h"
 #include "Protocol.h"
 #include <string>
 #include <array>
+#include <vector>
+#include <map>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+
+struct SendResult {
+	std::string recipient;
+	bool delivered;
+	std::string status;
+};
+
+struct OutgoingMessage {
+	std::string recipient;
+	MessageType type;
+	std::shared_ptr<const std::string> content;	// plain text or file contents; unused for key messages
+};
+
+// An operation the server or the local state refused; the connection is still usable.
+class OperationError : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
 
 class MessageUClient
 {
 public:
-	MessageUClient();
+	static const unsigned int DELIVERY_TIMEOUT_MS = 10000;
+	static const unsigned int RECEIVE_TIMEOUT_MS = 10000;
+	static const unsigned int INPUT_POLL_MS = 50;
+
+	MessageUClient(const ClientOptions& options);
 	~MessageUClient();
 
 	void run();
 
+	void reconnect();
+
+	bool waitForDelivery();
+
+	std::string registerClient(const std::string& name);
+
+	std::vector<std::string> requestClientList();
+
+	std::vector<SendResult> fetchPublicKeys(const std::vector<std::string>& names);
+
+	std::vector<SendResult> sendMessages(const std::vector<OutgoingMessage>& messages);
+
+	std::vector<SendResult> sendWithKeyExchange(const std::vector<OutgoingMessage>& messages);
+
+	void pullMessages(const std::function<void(const DecodedMessage&)>& visit);
+
+	std::vector<SendResult> sendTextToMany(const std::vector<std::string>& names, const std::string& text);
+
+	std::vector<SendResult> sendSharedMessage(const std::vector<std::string>& names, MessageType type, const std::string& content);
+
+	// seals the content once under a one-time key wrapped for every recipient; pairwise keys are untouched
+	std::vector<SendResult> sendToGroup(const std::vector<std::string>& names, MessageType type, std::shared_ptr<const std::string> content);
+
 private:
 	NetworkManager _netManager;
 	ClientRegistry _registry;
-	RSAPrivateWrapper* _myPrivateKey;
+	std::unique_ptr<LazyPrivateKey> _myPrivateKey;
+	OutboundJournal _journal;
+	OutboundSender _outboundSender;
+	MessageReceiver _receiver;
+	WorkerPool _workerPool;
 
+	ClientOptions _options;
+	std::pair<std::string, int> _server;
 	MyInfo _myInfo;
 	std::array<char, UUID_SIZE> _myUUID;
 	bool _isRegistered;
 
+	// rejections of sends nobody was waiting for, reported on the UI thread
+	std::mutex _rejectionsMutex;
+	std::vector<std::string> _rejections;
+
 	void connect();
 
+	std::ostream& console() const;
+
+	void requireRegistered() const;
+
+	std::string pullPayload();
+
+	uint8_t protocolFlags() const;
+
 	void loadMyInfo();
 
+	void startReceiver();
+
+	bool printIncoming();
+
+	void waitForInput();
+
+	void onSendCompleted(const std::string& packedRequest, const ServerResponse& response, bool awaited);
+
+	void markStored(std::future<ServerResponse>& response, std::chrono::steady_clock::time_point deadline,
+		const std::map<std::array<char, UUID_SIZE>, size_t>& resultIndex, std::vector<SendResult>& results);
+
+	void queueMessage(const std::array<char, UUID_SIZE>& targetID, MessageType type, const std::string& content);
+
 	void displayMenu();
 
 	int getUserSelection();
 
 	std::string getStringFromUser(const std::string& prompt);
 
-	void clearCinBuffer();
-
-	std::string getHexFromUUID(const std::string& uuid_bytes);
+	std::vector<std::string> getNamesFromUser(const std::string& prompt);
 
-	std::string getUUIDFromHex(const std::string& hex_string);
+	void clearCinBuffer();
 
 	void handleRegister();
 	void handleClientList();
 	void handlePublicKey();
 	void handlePullMessages();
 	void handleSendText();
+	void handleSendTextToMany();
+	void handleSendTextToGroup();
+	void handleRequestSymKeyFromMany();
 	void handleRequestSymKey();
 	void handleSendSymKey();
+	void handleNetworkStats();
 };
\ No newline at end of file
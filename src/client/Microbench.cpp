@@ -0,0 +1,376 @@
+#include "Request.h"
+#include "AESWrapper.h"
+#include "RSAWrapper.h"
+#include "Base64Wrapper.h"
+#include "UUIDHelper.h"
+#include "ClientRegistry.h"
+#include "PullBatch.h"
+#include "MessageReceiver.h"
+#include "ProtocolSchema.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Single-threaded microbenchmarks for the client's codec and crypto paths. Each result is
+// printed as one JSON object per line so runs can be collected and compared per commit.
+
+struct BenchOptions {
+	std::string filter;
+	std::string tag;
+	unsigned int minTimeMs = 200;
+	unsigned int repetitions = 5;
+};
+
+static volatile size_t g_sink;
+
+static void consume(size_t value)
+{
+	g_sink = g_sink + value;
+}
+
+static std::string jsonEscape(const std::string& value)
+{
+	std::string out;
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+		}
+		out.push_back(c);
+	}
+	return out;
+}
+
+class Bench
+{
+private:
+	BenchOptions _options;
+
+public:
+	Bench(const BenchOptions& options) : _options(options) {}
+
+	bool selected(const std::string& name) const
+	{
+		return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+	}
+
+	// bytesPerOp is 0 for operations where throughput in bytes isn't meaningful
+	void run(const std::string& name, size_t bytesPerOp, const std::function<void()>& op)
+	{
+		if (!selected(name)) {
+			return;
+		}
+
+		// grow the batch until one batch takes at least the minimum time
+		uint64_t iterations = 1;
+		while (true) {
+			double ns = timeBatch(op, iterations);
+			if (ns >= _options.minTimeMs * 1e6 || iterations >= (1ull << 30)) {
+				break;
+			}
+			double scale = ns > 0 ? (_options.minTimeMs * 1e6 * 1.2) / ns : 10.0;
+			iterations = static_cast<uint64_t>(iterations * std::clamp(scale, 1.5, 10.0)) + 1;
+		}
+
+		std::vector<double> perOp;
+		for (unsigned int i = 0; i < _options.repetitions; i++) {
+			perOp.push_back(timeBatch(op, iterations) / iterations);
+		}
+		std::sort(perOp.begin(), perOp.end());
+
+		double median = perOp[perOp.size() / 2];
+		std::ostringstream line;
+		line.precision(6);
+		line << "{\"benchmark\":\"" << jsonEscape(name) << "\"";
+		if (!_options.tag.empty()) {
+			line << ",\"tag\":\"" << jsonEscape(_options.tag) << "\"";
+		}
+		line << ",\"iterations\":" << iterations
+			<< ",\"ns_per_op\":" << median
+			<< ",\"ns_per_op_min\":" << perOp.front()
+			<< ",\"ns_per_op_max\":" << perOp.back();
+		if (bytesPerOp > 0) {
+			line << ",\"bytes_per_op\":" << bytesPerOp
+				<< ",\"mb_per_s\":" << (bytesPerOp / median) * 1e9 / (1024.0 * 1024.0);
+		}
+		line << "}";
+		std::cout << line.str() << std::endl;
+	}
+
+private:
+	static double timeBatch(const std::function<void()>& op, uint64_t iterations)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; i++) {
+			op();
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+static std::array<char, UUID_SIZE> makeUUID(uint64_t seed)
+{
+	std::array<char, UUID_SIZE> uuid;
+	std::mt19937_64 rng(seed);
+	uint64_t high = rng();
+	uint64_t low = rng();
+	memcpy(uuid.data(), &high, 8);
+	memcpy(uuid.data() + 8, &low, 8);
+	return uuid;
+}
+
+static std::string makeSymmetricKey()
+{
+	unsigned char key[AESWrapper::DEFAULT_KEYLENGTH];
+	AESWrapper::GenerateKey(key, AESWrapper::DEFAULT_KEYLENGTH);
+	return std::string(reinterpret_cast<char*>(key), AESWrapper::DEFAULT_KEYLENGTH);
+}
+
+static void benchRequests(Bench& bench)
+{
+	std::array<char, UUID_SIZE> me = makeUUID(1);
+	std::array<char, UUID_SIZE> peer = makeUUID(2);
+	std::string publicKey(PUBLIC_KEY_SIZE, 'k');
+
+	bench.run("pack/register", 0, [&] {
+		RegisterRequest req("benchmark-user", publicKey);
+		consume(req.getPackedRequest().size());
+	});
+	bench.run("pack/client_list", 0, [&] {
+		ClientListRequest req(me);
+		consume(req.getPackedRequest().size());
+	});
+	bench.run("pack/public_key", 0, [&] {
+		PublicKeyRequest req(me, peer);
+		consume(req.getPackedRequest().size());
+	});
+	bench.run("pack/pull", 0, [&] {
+		PullMessagesRequest req(me);
+		consume(req.getPackedRequest().size());
+	});
+
+	for (size_t size : { 64, 4096, 65536 }) {
+		std::string content(size, 'c');
+		bench.run("pack/send_message/" + std::to_string(size), size, [&] {
+			SendMessageRequest req(me, peer, MessageType::TEXT_MESSAGE, content);
+			consume(req.getPackedRequest().size());
+		});
+	}
+
+	std::vector<std::array<char, UUID_SIZE>> recipients;
+	for (uint64_t i = 0; i < 16; i++) {
+		recipients.push_back(makeUUID(100 + i));
+	}
+	std::string content(4096, 'c');
+	bench.run("pack/send_multi_message/16x4096", content.size(), [&] {
+		SendMultiMessageRequest req(me, recipients, MessageType::TEXT_MESSAGE, content);
+		consume(req.getPackedRequest().size());
+	});
+}
+
+static void benchAES(Bench& bench)
+{
+	std::string key = makeSymmetricKey();
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(key.data()), AESWrapper::DEFAULT_KEYLENGTH);
+
+	for (size_t size : { 16, 256, 4096, 65536, 1048576 }) {
+		std::string plain(size, 'p');
+		std::string cipher = aes.encrypt(plain.data(), (unsigned int)plain.size());
+		std::vector<char> out(cipher.size());
+
+		bench.run("aes/encrypt/" + std::to_string(size), size, [&] {
+			consume(aes.encrypt(plain.data(), (unsigned int)plain.size()).size());
+		});
+		bench.run("aes/decrypt/" + std::to_string(size), size, [&] {
+			consume(aes.decrypt(cipher.data(), (unsigned int)cipher.size()).size());
+		});
+		bench.run("aes/decrypt_into/" + std::to_string(size), size, [&] {
+			consume(aes.decrypt(cipher.data(), (unsigned int)cipher.size(), out.data()));
+		});
+	}
+}
+
+static void benchRSA(Bench& bench)
+{
+	RSAPrivateWrapper privateKey;
+	RSAPublicWrapper publicKey(privateKey.getPublicKey());
+	std::string symmetricKey = makeSymmetricKey();
+	std::string cipher = publicKey.encrypt(symmetricKey);
+
+	bench.run("rsa/public_encrypt/16", symmetricKey.size(), [&] {
+		consume(publicKey.encrypt(symmetricKey).size());
+	});
+	bench.run("rsa/private_decrypt/16", symmetricKey.size(), [&] {
+		consume(privateKey.decrypt(cipher).size());
+	});
+	std::string privateKeyRaw = privateKey.getPrivateKey();
+	bench.run("rsa/load_private_key", 0, [&] {
+		RSAPrivateWrapper loaded(privateKeyRaw);
+		consume(1);
+	});
+}
+
+static void benchBase64(Bench& bench)
+{
+	for (size_t size : { 160, 4096 }) {
+		std::string raw(size, '\x5a');
+		std::string encoded = Base64Wrapper::encode(raw);
+
+		bench.run("base64/encode/" + std::to_string(size), size, [&] {
+			consume(Base64Wrapper::encode(raw).size());
+		});
+		bench.run("base64/decode/" + std::to_string(size), size, [&] {
+			consume(Base64Wrapper::decode(encoded).size());
+		});
+	}
+}
+
+static void benchUUID(Bench& bench)
+{
+	std::array<char, UUID_SIZE> uuid = makeUUID(3);
+	std::string raw(uuid.data(), UUID_SIZE);
+	std::string hex = UUIDHelper::getHexFromUUID(raw);
+
+	bench.run("uuid/to_hex", UUID_SIZE, [&] {
+		consume(UUIDHelper::getHexFromUUID(raw).size());
+	});
+	bench.run("uuid/from_hex", UUID_SIZE, [&] {
+		consume(UUIDHelper::getUUIDFromHex(hex).size());
+	});
+}
+
+static void benchRegistry(Bench& bench)
+{
+	for (size_t entries : { 1000, 100000, 1000000 }) {
+		std::string suffix = "/" + std::to_string(entries);
+		if (!bench.selected("registry/find_by_uuid" + suffix) && !bench.selected("registry/find_by_name" + suffix)) {
+			continue;
+		}
+
+		ClientRegistry registry;
+		std::vector<std::array<char, UUID_SIZE>> uuids;
+		std::vector<std::string> names;
+		uuids.reserve(entries);
+		names.reserve(entries);
+		for (size_t i = 0; i < entries; i++) {
+			uuids.push_back(makeUUID(1000 + i));
+			names.push_back("user" + std::to_string(i));
+			registry.registerClient(uuids.back(), names.back());
+		}
+
+		// walk the keys in a shuffled order so lookups aren't served from a warm path
+		std::vector<size_t> order(entries);
+		for (size_t i = 0; i < entries; i++) {
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+		size_t next = 0;
+		bench.run("registry/find_by_uuid" + suffix, 0, [&] {
+			consume(registry.findByUUID(uuids[order[next++ % entries]]).has_value());
+		});
+		next = 0;
+		bench.run("registry/find_by_name" + suffix, 0, [&] {
+			consume(registry.findByName(names[order[next++ % entries]]).has_value());
+		});
+	}
+}
+
+static void benchPull(Bench& bench)
+{
+	LazyPrivateKey privateKey(Base64Wrapper::encode(RSAPrivateWrapper().getPrivateKey()));
+	std::array<char, UUID_SIZE> myUUID = makeUUID(499);
+	ClientRegistry registry;
+	const size_t senderCount = 8;
+	std::vector<std::array<char, UUID_SIZE>> senders;
+	std::vector<std::string> keys;
+	for (size_t i = 0; i < senderCount; i++) {
+		senders.push_back(makeUUID(500 + i));
+		keys.push_back(makeSymmetricKey());
+		registry.registerClient(senders.back(), "sender" + std::to_string(i));
+		registry.setSymmetricKey(senders.back(), keys.back());
+	}
+
+	for (size_t count : { 1, 32, 256 }) {
+		std::string payload;
+		for (size_t i = 0; i < count; i++) {
+			AESWrapper aes(reinterpret_cast<const unsigned char*>(keys[i % senderCount].data()), AESWrapper::DEFAULT_KEYLENGTH);
+			std::string text = "message " + std::to_string(i) + std::string(100, '.');
+			std::string cipher = aes.encrypt(text.data(), (unsigned int)text.size());
+
+			char header[PulledMessageLayout::size];
+			PulledMessageLayout::encode(header, senders[i % senderCount], static_cast<uint32_t>(i),
+				static_cast<uint8_t>(MessageType::TEXT_MESSAGE), static_cast<uint32_t>(cipher.size()));
+			payload.append(header, sizeof(header));
+			payload.append(cipher);
+		}
+
+		bench.run("pull/parse/" + std::to_string(count), payload.size(), [&] {
+			PullBatch batch(payload);
+			consume(batch.messages().size());
+		});
+		bench.run("pull/decrypt_format/" + std::to_string(count), payload.size(), [&] {
+			consume(MessageReceiver::formatBatch(payload, myUUID, registry, privateKey)->output().size());
+		});
+	}
+}
+
+static BenchOptions parseOptions(int argc, char* argv[])
+{
+	BenchOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			throw std::runtime_error("Error: Missing value for option '" + arg + "'.");
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--filter") {
+			options.filter = value;
+		}
+		else if (arg == "--tag") {
+			options.tag = value;
+		}
+		else if (arg == "--min-time") {
+			options.minTimeMs = std::stoul(value);
+		}
+		else if (arg == "--repetitions") {
+			options.repetitions = std::max(1ul, std::stoul(value));
+		}
+		else {
+			throw std::runtime_error("Error: Unknown command line option '" + arg + "'.");
+		}
+	}
+	return options;
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		Bench bench(parseOptions(argc, argv));
+		benchRequests(bench);
+		benchAES(bench);
+		benchRSA(bench);
+		benchBase64(bench);
+		benchUUID(bench);
+		benchRegistry(bench);
+		benchPull(bench);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Fatal Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
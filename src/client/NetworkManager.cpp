@@ -1,17 +1,15 @@
 #include "NetworkManager.h"
+#include "CompressionWrapper.h"
+#include "ProtocolSchema.h"
+#include "NetworkMetrics.h"
+#include "Tracer.h"
+#include "SessionRecorder.h"
 #include <stdexcept>
-#include <vector>
+#include <cstring>
+#include <algorithm>
 
-#pragma pack(push, 1)
-struct ResponseHeader {
-	uint8_t  version;
-	uint16_t code;
-	uint32_t payloadSize;
-};
-#pragma pack(pop)
 
-
-NetworkManager::NetworkManager() : _clientSocket(INVALID_SOCKET), _connected(false)
+NetworkManager::NetworkManager() : _clientSocket(INVALID_SOCKET), _connected(false), _everConnected(false), _connectionID(0)
 {
 	WSADATA wsaData;
 	int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -22,39 +20,74 @@ NetworkManager::NetworkManager() : _clientSocket(INVALID_SOCKET), _connected(fal
 
 NetworkManager::~NetworkManager()
 {
-	if (_connected) {
-		disconnect_server();
-	}
+	disconnect_server();
 	WSACleanup();
 }
 
-void NetworkManager::connect_to_server(const std::string& host, int port)
+std::mutex NetworkManager::_resolverMutex;
+std::map<std::string, std::vector<ResolvedAddress>> NetworkManager::_resolved;
+
+std::vector<ResolvedAddress> NetworkManager::resolve(const std::string& host, int port)
 {
-	if (_connected) {
-		disconnect_server();
+	std::string portStr = std::to_string(port);
+	std::string key = host + ":" + portStr;
+	{
+		std::lock_guard<std::mutex> lock(_resolverMutex);
+		auto it = _resolved.find(key);
+		if (it != _resolved.end()) {
+			return it->second;
+		}
 	}
 
+	TRACE_SCOPE("net.resolve");
 	addrinfo* result = nullptr;
 	addrinfo hints = {};
 	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_STREAM;
 	hints.ai_protocol = IPPROTO_TCP;
 
-	std::string portStr = std::to_string(port);
 	int iResult = getaddrinfo(host.c_str(), portStr.c_str(), &hints, &result);
 	if (iResult != 0) {
 		throw std::runtime_error("getaddrinfo failed: " + std::to_string(iResult));
 	}
 
+	std::vector<ResolvedAddress> addresses;
 	for (addrinfo* ptr = result; ptr != nullptr; ptr = ptr->ai_next)
 	{
-		_clientSocket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+		ResolvedAddress resolved = {};
+		resolved.family = ptr->ai_family;
+		resolved.socktype = ptr->ai_socktype;
+		resolved.protocol = ptr->ai_protocol;
+		resolved.addressLength = (int)ptr->ai_addrlen;
+		memcpy(&resolved.address, ptr->ai_addr, ptr->ai_addrlen);
+		addresses.push_back(resolved);
+	}
+	freeaddrinfo(result);
+
+	std::lock_guard<std::mutex> lock(_resolverMutex);
+	_resolved[key] = addresses;
+	return addresses;
+}
+
+void NetworkManager::forgetResolved(const std::string& host, int port)
+{
+	std::lock_guard<std::mutex> lock(_resolverMutex);
+	_resolved.erase(host + ":" + std::to_string(port));
+}
+
+void NetworkManager::connect_to_server(const std::string& host, int port)
+{
+	TRACE_SCOPE("net.connect");
+	disconnect_server();
+
+	for (const ResolvedAddress& resolved : resolve(host, port))
+	{
+		_clientSocket = socket(resolved.family, resolved.socktype, resolved.protocol);
 		if (_clientSocket == INVALID_SOCKET) {
-			freeaddrinfo(result);
 			throw std::runtime_error("Socket creation failed with error: " + std::to_string(WSAGetLastError()));
 		}
 
-		iResult = connect(_clientSocket, ptr->ai_addr, (int)ptr->ai_addrlen);
+		int iResult = connect(_clientSocket, reinterpret_cast<const sockaddr*>(&resolved.address), resolved.addressLength);
 		if (iResult == SOCKET_ERROR) {
 			closesocket(_clientSocket);
 			_clientSocket = INVALID_SOCKET;
@@ -63,38 +96,67 @@ void NetworkManager::connect_to_server(const std::string& host, int port)
 		break;
 	}
 
-	freeaddrinfo(result);
-
 	if (_clientSocket == INVALID_SOCKET) {
+		// the next attempt resolves again, in case the server moved
+		forgetResolved(host, port);
+		NetworkMetrics::instance().recordTransportError();
 		throw std::runtime_error("Unable to connect to server.");
 	}
 
 	_connected = true;
+	_connectionID = SessionRecorder::instance().nextConnectionID();
+	NetworkMetrics::instance().recordConnect(_everConnected);
+	_everConnected = true;
 }
 
 void NetworkManager::disconnect_server()
 {
-	if (_connected) {
+	// a failed receive already cleared _connected, but the socket is still ours to close
+	if (_clientSocket != INVALID_SOCKET) {
 		shutdown(_clientSocket, SD_SEND);
 		closesocket(_clientSocket);
 		_clientSocket = INVALID_SOCKET;
-		_connected = false;
 	}
+	_connected = false;
+	_inFlight.clear();
+}
+
+bool NetworkManager::is_connected() const
+{
+	return _connected;
 }
 
 void NetworkManager::send_data(const std::string& data)
 {
+	TRACE_SCOPE("net.send");
 	if (!_connected) {
 		throw std::runtime_error("Not connected to server.");
 	}
 
-	int bytesSent = send(_clientSocket, data.c_str(), (int)data.length(), 0);
-	if (bytesSent == SOCKET_ERROR) {
-		throw std::runtime_error("Send failed with error: " + std::to_string(WSAGetLastError()));
+	auto sentAt = std::chrono::steady_clock::now();
+	size_t totalBytesSent = 0;
+	while (totalBytesSent < data.length())
+	{
+		int bytesSent = send(_clientSocket, data.c_str() + totalBytesSent, (int)(data.length() - totalBytesSent), 0);
+		if (bytesSent == SOCKET_ERROR) {
+			NetworkMetrics::instance().recordTransportError();
+			throw std::runtime_error("Send failed with error: " + std::to_string(WSAGetLastError()));
+		}
+		totalBytesSent += bytesSent;
+	}
+	NetworkMetrics::instance().recordBytesSent(totalBytesSent);
+
+	SessionRecorder& recorder = SessionRecorder::instance();
+	if (recorder.active()) {
+		recorder.record(CaptureDirection::OUTBOUND, _connectionID, data.data(), data.length());
 	}
 
-	if (bytesSent < data.length()) {
-		throw std::runtime_error("Failed to send all data.");
+	// a buffer may carry several pipelined requests; remember each one's code for its response
+	size_t offset = 0;
+	while (data.length() - offset >= RequestHeaderLayout::size) {
+		auto [clientID, version, code, payloadSize] = RequestHeaderLayout::decode(data.data() + offset);
+		_inFlight.emplace_back(code, sentAt);
+		offset += RequestHeaderLayout::size + payloadSize;
 	}
 }
 
@@ -109,37 +171,77 @@ void NetworkManager::receive_exact(char* buffer, size_t size)
 			totalBytesReceived += bytesReceived;
 		}
 		else if (bytesReceived == 0) {
-			_connected = false;
+			disconnect_server();
+			NetworkMetrics::instance().recordTransportError();
 			throw std::runtime_error("Connection closed by server.");
 		}
 		else {
-			_connected = false;
-			throw std::runtime_error("Recv failed with error: " + std::to_string(WSAGetLastError()));
+			int error = WSAGetLastError();
+			disconnect_server();
+			NetworkMetrics::instance().recordTransportError();
+			throw std::runtime_error("Recv failed with error: " + std::to_string(error));
 		}
 	}
 }
 
+void NetworkManager::recordResponse(uint16_t responseCode, size_t wireBytes)
+{
+	NetworkMetrics& metrics = NetworkMetrics::instance();
+	metrics.recordBytesReceived(wireBytes);
+
+	if (_inFlight.empty()) {
+		return;
+	}
+	auto [requestCode, sentAt] = _inFlight.front();
+	_inFlight.pop_front();
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt);
+	metrics.recordRoundTrip(requestCode, responseCode, static_cast<uint64_t>(elapsed.count()));
+}
+
 ServerResponse NetworkManager::receive_response()
 {
+	TRACE_SCOPE("net.receive");
 	if (!_connected) {
 		throw std::runtime_error("Not connected to server.");
 	}
 
-	char headerBuffer[sizeof(ResponseHeader)];
-	receive_exact(headerBuffer, sizeof(ResponseHeader));
+	char headerBuffer[ResponseHeaderLayout::size];
+	receive_exact(headerBuffer, ResponseHeaderLayout::size);
 
-	ResponseHeader* header = reinterpret_cast<ResponseHeader*>(headerBuffer);
+	auto [version, code, payloadSize] = ResponseHeaderLayout::decode(headerBuffer);
 
-	if (header->payloadSize == 0) {
-		return { header->code, "" };
+	if (payloadSize > MAX_RESPONSE_PAYLOAD_SIZE) {
+		// the payload is never read, so nothing after it on this stream can be framed
+		disconnect_server();
+		NetworkMetrics::instance().recordTransportError();
+		throw std::runtime_error("Server response payload too large.");
 	}
 
-	if (header->payloadSize > 10 * 1024 * 1024) {
-		throw std::runtime_error("Server response payload too large.");
+	// a large pull is read in growing steps, so memory follows the bytes that actually arrive
+	std::string payload(std::min<size_t>(payloadSize, RECEIVE_CHUNK_SIZE), '\0');
+	size_t received = 0;
+	while (received < payloadSize)
+	{
+		if (received == payload.size()) {
+			payload.resize(std::min<size_t>(payloadSize, payload.size() * 2));
+		}
+		receive_exact(&payload[received], payload.size() - received);
+		received = payload.size();
 	}
+	recordResponse(code, ResponseHeaderLayout::size + payloadSize);
 
-	std::vector<char> payloadBuffer(header->payloadSize);
-	receive_exact(payloadBuffer.data(), header->payloadSize);
+	SessionRecorder& recorder = SessionRecorder::instance();
+	if (recorder.active()) {
+		recorder.record(CaptureDirection::INBOUND, _connectionID, headerBuffer, sizeof(headerBuffer), payload);
+	}
+
+	if (payloadSize == 0) {
+		return { code, "" };
+	}
+
+	if (version & PROTOCOL_FLAG_COMPRESSION) {
+		payload = CompressionWrapper::decompress(payload);
+	}
 
-	return { header->code, std::string(payloadBuffer.data(), payloadBuffer.size()) };
+	return { code, payload };
 }
\ No newline at end of file
@@ -7,6 +7,11 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <string>
+#include <deque>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
 #include <cstdint>
 
 #pragma comment(lib, "Ws2_32.lib")
@@ -16,15 +21,41 @@ struct ServerResponse {
 	std::string payload;
 };
 
+struct ResolvedAddress {
+	int family;
+	int socktype;
+	int protocol;
+	sockaddr_storage address;
+	int addressLength;
+};
+
 class NetworkManager
 {
 private:
+	// getaddrinfo results shared by every connection in the process, keyed by "host:port";
+	// an entry is dropped when none of its addresses accepts a connection
+	static std::mutex _resolverMutex;
+	static std::map<std::string, std::vector<ResolvedAddress>> _resolved;
+
+	static std::vector<ResolvedAddress> resolve(const std::string& host, int port);
+
+	static void forgetResolved(const std::string& host, int port);
+
 	SOCKET _clientSocket;
 	bool _connected;
+	bool _everConnected;
+	uint32_t _connectionID;
+
+	// requests written but not yet answered, oldest first; responses arrive in the same order
+	std::deque<std::pair<uint16_t, std::chrono::steady_clock::time_point>> _inFlight;
 
 	void receive_exact(char* buffer, size_t size);
 
+	void recordResponse(uint16_t responseCode, size_t wireBytes);
+
 public:
+	static const size_t RECEIVE_CHUNK_SIZE = 1024 * 1024;	// first step of a large response read
+
 	NetworkManager();
 
 	virtual ~NetworkManager();
@@ -33,6 +64,8 @@ public:
 
 	void disconnect_server();
 
+	bool is_connected() const;
+
 	void send_data(const std::string& data);
 
 	ServerResponse receive_response();
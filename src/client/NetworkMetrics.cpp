@@ -0,0 +1,188 @@
+#include "NetworkMetrics.h"
+#include <sstream>
+
+// Prometheus wants a fixed set of cumulative buckets; these are derived from the HDR counts.
+// Each target is exported at the upper edge of the HDR bucket holding it, so a bucket that
+// straddles the target is counted whole instead of dropped.
+static const uint64_t PROMETHEUS_BUCKETS_US[] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+// exact decimal seconds, so the le label matches the edge the count was taken at
+static std::string secondsLabel(uint64_t micros)
+{
+	std::string fraction = std::to_string(1000000 + micros % 1000000).substr(1);
+	fraction.erase(fraction.find_last_not_of('0') + 1);
+	return std::to_string(micros / 1000000) + (fraction.empty() ? "" : "." + fraction);
+}
+
+NetworkMetrics::NetworkMetrics() : _bytesSent(0), _bytesReceived(0), _transportErrors(0), _connects(0), _reconnects(0)
+{
+}
+
+NetworkMetrics& NetworkMetrics::instance()
+{
+	static NetworkMetrics metrics;
+	return metrics;
+}
+
+size_t NetworkMetrics::slot(uint16_t requestCode)
+{
+	if (requestCode >= FIRST_REQUEST_CODE && requestCode < FIRST_REQUEST_CODE + TRACKED_CODES - 1) {
+		return requestCode - FIRST_REQUEST_CODE;
+	}
+	return TRACKED_CODES - 1;
+}
+
+std::string NetworkMetrics::codeLabel(size_t slot)
+{
+	if (slot == TRACKED_CODES - 1) {
+		return "other";
+	}
+	return std::to_string(FIRST_REQUEST_CODE + slot);
+}
+
+void NetworkMetrics::recordRoundTrip(uint16_t requestCode, uint16_t responseCode, uint64_t micros)
+{
+	CodeMetrics& metrics = _codes[slot(requestCode)];
+	metrics.latency.record(micros);
+	if (responseCode == 9000) {
+		metrics.errorResponses.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void NetworkMetrics::recordBytesSent(uint64_t bytes)
+{
+	_bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void NetworkMetrics::recordBytesReceived(uint64_t bytes)
+{
+	_bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void NetworkMetrics::recordTransportError()
+{
+	_transportErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NetworkMetrics::recordConnect(bool reconnect)
+{
+	_connects.fetch_add(1, std::memory_order_relaxed);
+	if (reconnect) {
+		_reconnects.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+const LatencyHistogram& NetworkMetrics::latency(uint16_t requestCode) const
+{
+	return _codes[slot(requestCode)].latency;
+}
+
+uint64_t NetworkMetrics::requests(uint16_t requestCode) const
+{
+	return _codes[slot(requestCode)].latency.count();
+}
+
+uint64_t NetworkMetrics::errorResponses(uint16_t requestCode) const
+{
+	return _codes[slot(requestCode)].errorResponses.load(std::memory_order_relaxed);
+}
+
+uint64_t NetworkMetrics::bytesSent() const
+{
+	return _bytesSent.load(std::memory_order_relaxed);
+}
+
+uint64_t NetworkMetrics::bytesReceived() const
+{
+	return _bytesReceived.load(std::memory_order_relaxed);
+}
+
+uint64_t NetworkMetrics::transportErrors() const
+{
+	return _transportErrors.load(std::memory_order_relaxed);
+}
+
+uint64_t NetworkMetrics::connects() const
+{
+	return _connects.load(std::memory_order_relaxed);
+}
+
+uint64_t NetworkMetrics::reconnects() const
+{
+	return _reconnects.load(std::memory_order_relaxed);
+}
+
+std::string NetworkMetrics::toJson() const
+{
+	std::ostringstream out;
+	out << "{\"bytes_sent\":" << bytesSent()
+		<< ",\"bytes_received\":" << bytesReceived()
+		<< ",\"transport_errors\":" << transportErrors()
+		<< ",\"connects\":" << connects()
+		<< ",\"reconnects\":" << reconnects()
+		<< ",\"requests\":{";
+
+	bool first = true;
+	for (size_t i = 0; i < TRACKED_CODES; i++)
+	{
+		const CodeMetrics& metrics = _codes[i];
+		uint64_t count = metrics.latency.count();
+		if (count == 0) {
+			continue;
+		}
+		if (!first) {
+			out << ",";
+		}
+		first = false;
+
+		out << "\"" << codeLabel(i) << "\":{\"count\":" << count
+			<< ",\"error_responses\":" << metrics.errorResponses.load(std::memory_order_relaxed)
+			<< ",\"mean_us\":" << metrics.latency.sum() / count
+			<< ",\"p50_us\":" << metrics.latency.quantile(0.50)
+			<< ",\"p90_us\":" << metrics.latency.quantile(0.90)
+			<< ",\"p99_us\":" << metrics.latency.quantile(0.99)
+			<< ",\"p999_us\":" << metrics.latency.quantile(0.999)
+			<< ",\"max_us\":" << metrics.latency.max() << "}";
+	}
+	out << "}}";
+	return out.str();
+}
+
+std::string NetworkMetrics::toPrometheus() const
+{
+	std::ostringstream out;
+	out << "# HELP messageu_request_duration_seconds Round trip from send to complete response, per request code.\n";
+	out << "# TYPE messageu_request_duration_seconds histogram\n";
+	for (size_t i = 0; i < TRACKED_CODES; i++)
+	{
+		const LatencyHistogram& latency = _codes[i].latency;
+		if (latency.count() == 0) {
+			continue;
+		}
+		std::string label = "code=\"" + codeLabel(i) + "\"";
+		for (uint64_t target : PROMETHEUS_BUCKETS_US) {
+			uint64_t bound = LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(target));
+			out << "messageu_request_duration_seconds_bucket{" << label << ",le=\"" << secondsLabel(bound) << "\"} " << latency.countAtOrBelow(bound) << "\n";
+		}
+		out << "messageu_request_duration_seconds_bucket{" << label << ",le=\"+Inf\"} " << latency.count() << "\n";
+		out << "messageu_request_duration_seconds_sum{" << label << "} " << latency.sum() / 1e6 << "\n";
+		out << "messageu_request_duration_seconds_count{" << label << "} " << latency.count() << "\n";
+	}
+
+	out << "# HELP messageu_error_responses_total Requests answered with a general error (9000).\n";
+	out << "# TYPE messageu_error_responses_total counter\n";
+	for (size_t i = 0; i < TRACKED_CODES; i++) {
+		if (_codes[i].latency.count() > 0) {
+			out << "messageu_error_responses_total{code=\"" << codeLabel(i) << "\"} " << _codes[i].errorResponses.load(std::memory_order_relaxed) << "\n";
+		}
+	}
+
+	out << "# TYPE messageu_bytes_sent_total counter\nmessageu_bytes_sent_total " << bytesSent() << "\n";
+	out << "# TYPE messageu_bytes_received_total counter\nmessageu_bytes_received_total " << bytesReceived() << "\n";
+	out << "# TYPE messageu_transport_errors_total counter\nmessageu_transport_errors_total " << transportErrors() << "\n";
+	out << "# TYPE messageu_connects_total counter\nmessageu_connects_total " << connects() << "\n";
+	out << "# TYPE messageu_reconnects_total counter\nmessageu_reconnects_total " << reconnects() << "\n";
+	return out.str();
+}
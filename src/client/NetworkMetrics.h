@@ -0,0 +1,58 @@
+#pragma once
+#include "LatencyHistogram.h"
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Process-wide counters for every NetworkManager. Round-trip latency is measured from the
+// moment a request is handed to the socket until its response is fully read, so it covers
+// network and server time only; client-side crypto and parsing are outside the window.
+class NetworkMetrics
+{
+public:
+	static const uint16_t FIRST_REQUEST_CODE = 600;
+	static const size_t TRACKED_CODES = 7;	// 600..605 plus one slot for anything else
+
+	static NetworkMetrics& instance();
+
+	void recordRoundTrip(uint16_t requestCode, uint16_t responseCode, uint64_t micros);
+	void recordBytesSent(uint64_t bytes);
+	void recordBytesReceived(uint64_t bytes);
+	void recordTransportError();
+	void recordConnect(bool reconnect);
+
+	const LatencyHistogram& latency(uint16_t requestCode) const;
+	uint64_t requests(uint16_t requestCode) const;
+	uint64_t errorResponses(uint16_t requestCode) const;
+	uint64_t bytesSent() const;
+	uint64_t bytesReceived() const;
+	uint64_t transportErrors() const;
+	uint64_t connects() const;
+	uint64_t reconnects() const;
+
+	std::string toJson() const;
+
+	std::string toPrometheus() const;
+
+private:
+	struct CodeMetrics {
+		LatencyHistogram latency;
+		std::atomic<uint64_t> errorResponses{ 0 };
+	};
+
+	std::array<CodeMetrics, TRACKED_CODES> _codes;
+	std::atomic<uint64_t> _bytesSent;
+	std::atomic<uint64_t> _bytesReceived;
+	std::atomic<uint64_t> _transportErrors;
+	std::atomic<uint64_t> _connects;
+	std::atomic<uint64_t> _reconnects;
+
+	NetworkMetrics();
+	NetworkMetrics(const NetworkMetrics&) = delete;
+	NetworkMetrics& operator=(const NetworkMetrics&) = delete;
+
+	static size_t slot(uint16_t requestCode);
+
+	static std::string codeLabel(size_t slot);
+};
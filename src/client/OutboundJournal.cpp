@@ -0,0 +1,211 @@
+#include "OutboundJournal.h"
+#include "ProtocolSchema.h"
+#include <stdexcept>
+#include <filesystem>
+#include <io.h>
+
+// record layout: type(1) + id(8) + length(4), followed by length bytes of data
+using JournalRecordLayout = schema::Layout<schema::UInt<uint8_t>, schema::UInt<uint64_t>, schema::UInt<uint32_t>>;
+
+static uint64_t recordSize(size_t dataLength)
+{
+	return JournalRecordLayout::size + dataLength;
+}
+
+
+OutboundJournal::OutboundJournal(const std::string& path) : _path(path), _file(nullptr), _nextID(1), _deadBytes(0)
+{
+	load();
+
+	if (fopen_s(&_file, _path.c_str(), "ab") != 0) {
+		throw std::runtime_error("Error: Could not open " + _path + " for writing.");
+	}
+	if (_deadBytes >= COMPACT_THRESHOLD) {
+		compact();
+	}
+}
+
+OutboundJournal::~OutboundJournal()
+{
+	if (_file) {
+		fclose(_file);
+	}
+}
+
+void OutboundJournal::load()
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, _path.c_str(), "rb") != 0) {
+		return;
+	}
+
+	char header[JournalRecordLayout::size];
+	while (fread(header, 1, JournalRecordLayout::size, file) == JournalRecordLayout::size)
+	{
+		auto [rawType, id, length] = JournalRecordLayout::decode(header);
+		RecordType type = static_cast<RecordType>(rawType);
+
+		std::string data(length, '\0');
+		if (length > 0 && fread(&data[0], 1, length, file) != length) {
+			// torn write at the tail: the entry was never acknowledged to the user as queued
+			break;
+		}
+
+		if (type == RecordType::ENTRY) {
+			_pending[id] = data;
+		}
+		else if (type == RecordType::ACK) {
+			auto it = _pending.find(id);
+			if (it != _pending.end()) {
+				_deadBytes += recordSize(it->second.length());
+				_pending.erase(it);
+			}
+			_deadBytes += recordSize(0);
+		}
+
+		if (id >= _nextID) {
+			_nextID = id + 1;
+		}
+	}
+
+	fclose(file);
+}
+
+void OutboundJournal::writeRecord(RecordType type, uint64_t id, const std::string& data)
+{
+	char header[JournalRecordLayout::size];
+	JournalRecordLayout::encode(header, static_cast<uint8_t>(type), id, (uint32_t)data.length());
+
+	if (fwrite(header, 1, JournalRecordLayout::size, _file) != JournalRecordLayout::size ||
+		fwrite(data.data(), 1, data.length(), _file) != data.length()) {
+		throw std::runtime_error("Error: Failed to write to " + _path + ".");
+	}
+}
+
+void OutboundJournal::sync()
+{
+	if (fflush(_file) != 0 || _commit(_fileno(_file)) != 0) {
+		throw std::runtime_error("Error: Failed to flush " + _path + " to disk.");
+	}
+}
+
+void OutboundJournal::truncate()
+{
+	fclose(_file);
+	if (fopen_s(&_file, _path.c_str(), "wb") != 0) {
+		throw std::runtime_error("Error: Could not open " + _path + " for writing.");
+	}
+	_deadBytes = 0;
+}
+
+// writes the pending entries to a new file and swaps it in, so a journal that never drains
+// still stays proportional to what is outstanding
+void OutboundJournal::compact()
+{
+	std::string tempPath = _path + ".tmp";
+	FILE* temp = nullptr;
+	if (fopen_s(&temp, tempPath.c_str(), "wb") != 0) {
+		throw std::runtime_error("Error: Could not open " + tempPath + " for writing.");
+	}
+
+	FILE* current = _file;
+	_file = temp;
+	try {
+		for (const auto& pair : _pending) {
+			writeRecord(RecordType::ENTRY, pair.first, pair.second);
+		}
+		sync();
+	}
+	catch (...) {
+		fclose(temp);
+		_file = current;
+		std::filesystem::remove(tempPath);
+		throw;
+	}
+
+	fclose(temp);
+	fclose(current);
+	_file = nullptr;
+	std::filesystem::rename(tempPath, _path);
+
+	if (fopen_s(&_file, _path.c_str(), "ab") != 0) {
+		throw std::runtime_error("Error: Could not open " + _path + " for writing.");
+	}
+	_deadBytes = 0;
+}
+
+uint64_t OutboundJournal::append(const std::string& packedRequest)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	uint64_t id = _nextID++;
+	writeRecord(RecordType::ENTRY, id, packedRequest);
+	sync();
+
+	_pending[id] = packedRequest;
+	return id;
+}
+
+std::vector<uint64_t> OutboundJournal::appendAll(const std::vector<std::string>& packedRequests)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::vector<uint64_t> ids;
+	ids.reserve(packedRequests.size());
+	for (const std::string& packedRequest : packedRequests) {
+		uint64_t id = _nextID++;
+		writeRecord(RecordType::ENTRY, id, packedRequest);
+		ids.push_back(id);
+	}
+	sync();
+
+	for (size_t i = 0; i < ids.size(); i++) {
+		_pending[ids[i]] = packedRequests[i];
+	}
+	return ids;
+}
+
+std::vector<JournalEntry> OutboundJournal::getPending(size_t maxEntries) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::vector<JournalEntry> entries;
+	for (const auto& pair : _pending) {
+		if (entries.size() >= maxEntries) {
+			break;
+		}
+		entries.push_back({ pair.first, pair.second });
+	}
+	return entries;
+}
+
+void OutboundJournal::acknowledge(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto it = _pending.find(id);
+	if (it == _pending.end()) {
+		return;
+	}
+	_deadBytes += recordSize(it->second.length()) + recordSize(0);
+	_pending.erase(it);
+
+	if (_pending.empty()) {
+		truncate();
+		return;
+	}
+
+	if (_deadBytes >= COMPACT_THRESHOLD) {
+		compact();
+		return;
+	}
+
+	writeRecord(RecordType::ACK, id, "");
+	fflush(_file);
+}
+
+size_t OutboundJournal::pendingCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _pending.size();
+}
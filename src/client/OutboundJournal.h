@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <cstdio>
+
+struct JournalEntry {
+	uint64_t id;
+	std::string packedRequest;
+};
+
+// Append-only on-disk log of outgoing requests. An entry stays pending until it is
+// acknowledged; acknowledgements are appended as tombstones and the file is truncated
+// once nothing is left pending, or rewritten from the pending entries once acknowledged
+// records make up most of it.
+class OutboundJournal
+{
+private:
+	enum class RecordType : uint8_t
+	{
+		ENTRY = 1,
+		ACK = 2
+	};
+
+	std::string _path;
+	FILE* _file;
+	std::map<uint64_t, std::string> _pending;
+	uint64_t _nextID;
+	uint64_t _deadBytes;	// acknowledged entries and their tombstones still in the file
+	mutable std::mutex _mutex;
+
+	void load();
+
+	void writeRecord(RecordType type, uint64_t id, const std::string& data);
+
+	void sync();
+
+	void truncate();
+
+	void compact();
+
+public:
+	static const uint64_t COMPACT_THRESHOLD = 4 * 1024 * 1024;
+
+	OutboundJournal(const std::string& path);
+	~OutboundJournal();
+
+	uint64_t append(const std::string& packedRequest);
+
+	std::vector<uint64_t> appendAll(const std::vector<std::string>& packedRequests);
+
+	std::vector<JournalEntry> getPending(size_t maxEntries) const;
+
+	void acknowledge(uint64_t id);
+
+	size_t pendingCount() const;
+};
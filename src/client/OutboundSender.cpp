@@ -0,0 +1,152 @@
+#include "OutboundSender.h"
+#include <iostream>
+#include <chrono>
+
+OutboundSender::OutboundSender(OutboundJournal& journal)
+	: _journal(journal), _port(0), _stopping(false), _notified(false)
+{
+}
+
+OutboundSender::~OutboundSender()
+{
+	stop();
+}
+
+void OutboundSender::setCompletionHandler(CompletionHandler handler)
+{
+	_onCompleted = std::move(handler);
+}
+
+void OutboundSender::start(const std::string& host, int port)
+{
+	_host = host;
+	_port = port;
+	_stopping = false;
+	_thread = std::thread(&OutboundSender::run, this);
+}
+
+void OutboundSender::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wakeup.notify_one();
+
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+	_netManager.disconnect_server();
+}
+
+void OutboundSender::notify()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_notified = true;
+	}
+	_wakeup.notify_one();
+}
+
+bool OutboundSender::waitUntilIdle(unsigned int timeoutMs)
+{
+	notify();
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _idle.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return _journal.pendingCount() == 0; });
+}
+
+std::vector<std::future<ServerResponse>> OutboundSender::submit(const std::vector<std::string>& packedRequests)
+{
+	std::vector<std::future<ServerResponse>> results;
+	{
+		// held across the append so a fast response can't complete an entry before its waiter exists
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::vector<uint64_t> ids = _journal.appendAll(packedRequests);
+
+		results.reserve(ids.size());
+		for (uint64_t id : ids) {
+			results.push_back(_waiters[id].get_future());
+		}
+		_notified = true;
+	}
+	_wakeup.notify_one();
+	return results;
+}
+
+void OutboundSender::completeEntry(const JournalEntry& entry, const ServerResponse& response)
+{
+	_journal.acknowledge(entry.id);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _waiters.find(entry.id);
+	bool awaited = (it != _waiters.end());
+	if (_onCompleted) {
+		_onCompleted(entry.packedRequest, response, awaited);
+	}
+	else if (!awaited && response.code == 9000) {
+		std::cerr << "Queued message " << entry.id << " was rejected by the server." << std::endl;
+	}
+
+	if (awaited) {
+		it->second.set_value(response);
+		_waiters.erase(it);
+	}
+	if (_journal.pendingCount() == 0) {
+		_idle.notify_all();
+	}
+}
+
+void OutboundSender::run()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeup.wait_for(lock, std::chrono::milliseconds(RETRY_INTERVAL_MS), [this] { return _stopping || _notified; });
+			if (_stopping) {
+				return;
+			}
+			_notified = false;
+		}
+
+		try {
+			while (_journal.pendingCount() > 0) {
+				flushBatch();
+
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_stopping) {
+					return;
+				}
+			}
+		}
+		catch (const std::exception&) {
+			// server unreachable; entries stay journaled and are retried on the next wakeup
+			_netManager.disconnect_server();
+		}
+	}
+}
+
+void OutboundSender::flushBatch()
+{
+	std::vector<JournalEntry> batch = _journal.getPending(MAX_BATCH_SIZE);
+	if (batch.empty()) {
+		return;
+	}
+
+	if (!_netManager.is_connected()) {
+		_netManager.connect_to_server(_host, _port);
+	}
+
+	std::string pipelined;
+	for (const JournalEntry& entry : batch) {
+		pipelined.append(entry.packedRequest);
+	}
+	_netManager.send_data(pipelined);
+
+	// the server answers requests on a connection in order, so responses map to the batch by position
+	for (const JournalEntry& entry : batch) {
+		ServerResponse res = _netManager.receive_response();
+		completeEntry(entry, res);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "NetworkManager.h"
+#include "OutboundJournal.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+class OutboundSender
+{
+public:
+	static const size_t MAX_BATCH_SIZE = 256;
+	static const unsigned int RETRY_INTERVAL_MS = 2000;
+
+	// runs on the sender thread for every answered entry, before its waiter (if any) is woken;
+	// `awaited` is false for entries nobody holds a future for, such as ones replayed from the journal
+	using CompletionHandler = std::function<void(const std::string& packedRequest, const ServerResponse& response, bool awaited)>;
+
+	OutboundSender(OutboundJournal& journal);
+	~OutboundSender();
+
+	void setCompletionHandler(CompletionHandler handler);
+
+	void start(const std::string& host, int port);
+
+	void stop();
+
+	void notify();
+
+	bool waitUntilIdle(unsigned int timeoutMs);
+
+	std::vector<std::future<ServerResponse>> submit(const std::vector<std::string>& packedRequests);
+
+private:
+	OutboundJournal& _journal;
+	NetworkManager _netManager;
+	std::string _host;
+	int _port;
+
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	std::condition_variable _idle;
+	bool _stopping;
+	bool _notified;
+	std::map<uint64_t, std::promise<ServerResponse>> _waiters;
+	CompletionHandler _onCompleted;
+
+	void run();
+
+	void flushBatch();
+
+	void completeEntry(const JournalEntry& entry, const ServerResponse& response);
+};
@@ -3,6 +3,24 @@
 
 const uint8_t CLIENT_VERSION = 1;
 
+// high bit of the header version byte: payloads may be zlib-compressed (negotiated per request);
+// the client only sets it on CLIENT_LIST and PULL_MESSAGES, and never compresses what it sends
+const uint8_t PROTOCOL_FLAG_COMPRESSION = 0x80;
+const uint8_t PROTOCOL_VERSION_MASK = 0x7F;
+
+// high bit of the message type byte: plaintext was zlib-compressed before encryption; honoured
+// on receipt, but never set when sending, since older recipients reject the type
+const uint8_t MESSAGE_FLAG_COMPRESSED = 0x80;
+
+// next bit of the message type byte: the content starts with a one-time key wrapped for each
+// recipient (GroupKeyCountLayout, then GroupKeyEntryLayout + wrapped key per recipient) and the
+// rest is sealed under that key; the key is never stored as the pairwise key with the sender
+const uint8_t MESSAGE_FLAG_GROUP_KEYS = 0x40;
+
+// the servers refuse requests with a larger payload and fill a pull only up to this size; a
+// message that is larger on its own still goes out alone (see MAX_RESPONSE_PAYLOAD_SIZE)
+const uint32_t MAX_PAYLOAD_SIZE = 64 * 1024 * 1024;
+
 const size_t CLIENT_NAME_SIZE = 255;
 const size_t PUBLIC_KEY_SIZE = 160;
 const size_t UUID_SIZE = 16;
@@ -13,7 +31,8 @@ enum class RequestCode : uint16_t
 	CLIENT_LIST = 601,
 	PUBLIC_KEY = 602,
 	SEND_MESSAGE = 603,
-	PULL_MESSAGES = 604
+	PULL_MESSAGES = 604,
+	SEND_MULTI_MESSAGE = 605
 };
 
 enum class MessageType : uint8_t
@@ -0,0 +1,200 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include "Protocol.h"
+
+// Wire layouts are declared once as a list of fixed-size fields. Offsets and sizes are
+// computed at compile time, so encode/decode compile down to straight-line stores and loads.
+namespace schema
+{
+	// little-endian unsigned integer
+	template <typename T>
+	struct UInt
+	{
+		static_assert(std::is_unsigned<T>::value, "UInt fields must be unsigned");
+
+		using value_type = T;
+		static constexpr size_t size = sizeof(T);
+
+		static void encode(char* out, T value)
+		{
+			for (size_t i = 0; i < size; i++) {
+				out[i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i));
+			}
+		}
+
+		static T decode(const char* in)
+		{
+			uint64_t value = 0;
+			for (size_t i = 0; i < size; i++) {
+				value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+			}
+			return static_cast<T>(value);
+		}
+	};
+
+	// fixed-size raw byte field (UUIDs, NUL padded names, keys)
+	template <size_t N>
+	struct Bytes
+	{
+		using value_type = std::array<char, N>;
+		static constexpr size_t size = N;
+
+		static void encode(char* out, const value_type& value)
+		{
+			memcpy(out, value.data(), N);
+		}
+
+		static value_type decode(const char* in)
+		{
+			value_type value;
+			memcpy(value.data(), in, N);
+			return value;
+		}
+	};
+
+	template <typename... Fields>
+	struct Layout
+	{
+		static constexpr size_t size = (Fields::size + ...);
+		static constexpr size_t fieldCount = sizeof...(Fields);
+
+		using Values = std::tuple<typename Fields::value_type...>;
+
+		static constexpr std::array<size_t, fieldCount> offsets()
+		{
+			std::array<size_t, fieldCount> result = {};
+			size_t sizes[] = { Fields::size... };
+			size_t offset = 0;
+			for (size_t i = 0; i < fieldCount; i++) {
+				result[i] = offset;
+				offset += sizes[i];
+			}
+			return result;
+		}
+
+		static void encode(char* out, const typename Fields::value_type&... values)
+		{
+			encodeFields(out, std::index_sequence_for<Fields...>{}, values...);
+		}
+
+		// caller guarantees at least `size` readable bytes; use Reader for untrusted input
+		static Values decode(const char* in)
+		{
+			return decodeFields(in, std::index_sequence_for<Fields...>{});
+		}
+
+	private:
+		template <size_t... I>
+		static void encodeFields(char* out, std::index_sequence<I...>, const typename Fields::value_type&... values)
+		{
+			constexpr std::array<size_t, fieldCount> fieldOffsets = offsets();
+			(Fields::encode(out + fieldOffsets[I], values), ...);
+		}
+
+		template <size_t... I>
+		static Values decodeFields(const char* in, std::index_sequence<I...>)
+		{
+			constexpr std::array<size_t, fieldCount> fieldOffsets = offsets();
+			return Values(Fields::decode(in + fieldOffsets[I])...);
+		}
+	};
+
+	// bounds-checked cursor over a received payload; variable-length fields are returned as views
+	class Reader
+	{
+	private:
+		std::string_view _data;
+		size_t _offset;
+
+		void require(size_t size) const
+		{
+			if (size > _data.size() - _offset) {
+				throw std::runtime_error("Truncated protocol payload.");
+			}
+		}
+
+	public:
+		explicit Reader(std::string_view data) : _data(data), _offset(0) {}
+
+		template <typename L>
+		typename L::Values read()
+		{
+			require(L::size);
+			typename L::Values values = L::decode(_data.data() + _offset);
+			_offset += L::size;
+			return values;
+		}
+
+		std::string_view bytes(size_t size)
+		{
+			require(size);
+			std::string_view view = _data.substr(_offset, size);
+			_offset += size;
+			return view;
+		}
+
+		size_t remaining() const { return _data.size() - _offset; }
+
+		bool empty() const { return _offset == _data.size(); }
+	};
+
+	// copies a string into a NUL padded fixed-size field
+	template <size_t N>
+	std::array<char, N> padded(std::string_view value)
+	{
+		std::array<char, N> field = {};
+		memcpy(field.data(), value.data(), value.length() < N ? value.length() : N);
+		return field;
+	}
+
+	// reads a NUL terminated string out of a fixed-size field
+	template <size_t N>
+	std::string unpadded(const std::array<char, N>& field)
+	{
+		const char* end = static_cast<const char*>(memchr(field.data(), '\0', N));
+		return std::string(field.data(), end ? static_cast<size_t>(end - field.data()) : N);
+	}
+}
+
+
+using RequestHeaderLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::UInt<uint8_t>, schema::UInt<uint16_t>, schema::UInt<uint32_t>>;
+using ResponseHeaderLayout = schema::Layout<schema::UInt<uint8_t>, schema::UInt<uint16_t>, schema::UInt<uint32_t>>;
+
+// request payloads
+using RegisterPayloadLayout = schema::Layout<schema::Bytes<CLIENT_NAME_SIZE>, schema::Bytes<PUBLIC_KEY_SIZE>>;
+using PublicKeyPayloadLayout = schema::Layout<schema::Bytes<UUID_SIZE>>;
+using SendMessagePayloadLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::UInt<uint8_t>, schema::UInt<uint32_t>>;
+using MultiRecipientCountLayout = schema::Layout<schema::UInt<uint16_t>>;
+using MultiRecipientLayout = schema::Layout<schema::Bytes<UUID_SIZE>>;
+using MultiMessageContentLayout = schema::Layout<schema::UInt<uint8_t>, schema::UInt<uint32_t>>;
+
+// message content with MESSAGE_FLAG_GROUP_KEYS: an entry per recipient, each followed by its wrapped key
+using GroupKeyCountLayout = schema::Layout<schema::UInt<uint16_t>>;
+using GroupKeyEntryLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::UInt<uint16_t>>;
+
+// response payloads
+using RegisterSuccessLayout = schema::Layout<schema::Bytes<UUID_SIZE>>;
+using ClientListRecordLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::Bytes<CLIENT_NAME_SIZE>>;
+using PublicKeyResponseLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::Bytes<PUBLIC_KEY_SIZE>>;
+using MessageStoredLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::UInt<uint32_t>>;
+using PulledMessageLayout = schema::Layout<schema::Bytes<UUID_SIZE>, schema::UInt<uint32_t>, schema::UInt<uint8_t>, schema::UInt<uint32_t>>;
+
+// a pull of one message that alone fills MAX_PAYLOAD_SIZE carries its record header on top
+constexpr uint32_t MAX_RESPONSE_PAYLOAD_SIZE = MAX_PAYLOAD_SIZE + PulledMessageLayout::size;
+
+static_assert(RequestHeaderLayout::size == 23, "request header is 23 bytes on the wire");
+static_assert(ResponseHeaderLayout::size == 7, "response header is 7 bytes on the wire");
+static_assert(RegisterPayloadLayout::size == 415, "register payload is name(255) + public key(160)");
+static_assert(SendMessagePayloadLayout::size == 21, "send message header is uuid(16) + type(1) + size(4)");
+static_assert(ClientListRecordLayout::size == 271, "client list record is uuid(16) + name(255)");
+static_assert(PublicKeyResponseLayout::size == 176, "public key response is uuid(16) + key(160)");
+static_assert(MessageStoredLayout::size == 20, "message stored response is uuid(16) + message id(4)");
+static_assert(PulledMessageLayout::size == 25, "pulled message header is uuid(16) + id(4) + type(1) + size(4)");
@@ -0,0 +1,68 @@
+#include "PullBatch.h"
+#include "ProtocolSchema.h"
+#include "Tracer.h"
+
+static size_t countMessages(std::string_view payload)
+{
+	size_t count = 0;
+	schema::Reader reader(payload);
+	while (!reader.empty())
+	{
+		auto [fromUUID, msgID, rawType, contentSize] = reader.read<PulledMessageLayout>();
+		reader.bytes(contentSize);
+		count++;
+	}
+	return count;
+}
+
+// sized so a whole batch is served by the arena's first block: the message table, decrypted
+// plaintext (never longer than its cipher) and the formatted output with per-message framing
+static size_t initialArenaSize(std::string_view payload, size_t messageCount)
+{
+	const size_t framingPerMessage = 128;
+	return messageCount * (sizeof(PulledMessage) + framingPerMessage) + payload.size() * 2;
+}
+
+PullBatch::PullBatch(std::string_view payload) : PullBatch(payload, countMessages(payload))
+{
+}
+
+PullBatch::PullBatch(std::string_view payload, size_t messageCount)
+	: _arena(initialArenaSize(payload, messageCount)), _messages(&_arena), _output(&_arena)
+{
+	TRACE_SCOPE("pull.parse");
+	_messages.reserve(messageCount);
+
+	schema::Reader reader(payload);
+	while (!reader.empty())
+	{
+		auto [fromUUID, msgID, rawType, contentSize] = reader.read<PulledMessageLayout>();
+		std::string_view content = reader.bytes(contentSize);
+
+		bool compressed = (rawType & MESSAGE_FLAG_COMPRESSED) != 0;
+		bool groupKeys = (rawType & MESSAGE_FLAG_GROUP_KEYS) != 0;
+		MessageType type = static_cast<MessageType>(rawType & ~(MESSAGE_FLAG_COMPRESSED | MESSAGE_FLAG_GROUP_KEYS));
+
+		_messages.push_back({ fromUUID, msgID, type, compressed, groupKeys, content });
+	}
+}
+
+const std::pmr::vector<PulledMessage>& PullBatch::messages() const
+{
+	return _messages;
+}
+
+std::pmr::memory_resource* PullBatch::arena()
+{
+	return &_arena;
+}
+
+char* PullBatch::allocate(size_t size)
+{
+	return static_cast<char*>(_arena.allocate(size == 0 ? 1 : size, 1));
+}
+
+std::pmr::string& PullBatch::output()
+{
+	return _output;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <vector>
+#include <cstdint>
+#include "Protocol.h"
+
+struct PulledMessage {
+	std::array<char, UUID_SIZE> fromUUID;
+	uint32_t id;
+	MessageType type;
+	bool compressed;
+	bool groupKeys;
+	std::string_view content;
+};
+
+// Decoded PULL_MESSAGES payload. Message contents are views into the payload, and everything
+// produced while handling the batch (decrypted text, output, decryptor cache) is allocated
+// from one arena that is released in a single step when the batch goes out of scope. A batch
+// kept after its payload is gone, as formatted batches waiting in the receiver's inbox are,
+// must only be used through output().
+class PullBatch
+{
+private:
+	std::pmr::monotonic_buffer_resource _arena;
+	std::pmr::vector<PulledMessage> _messages;
+	std::pmr::string _output;
+
+	PullBatch(std::string_view payload, size_t messageCount);
+
+public:
+	PullBatch(std::string_view payload);
+
+	PullBatch(const PullBatch&) = delete;
+	PullBatch& operator=(const PullBatch&) = delete;
+
+	const std::pmr::vector<PulledMessage>& messages() const;
+
+	std::pmr::memory_resource* arena();
+
+	char* allocate(size_t size);
+
+	std::pmr::string& output();
+};
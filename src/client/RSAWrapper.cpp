@@ -1,4 +1,5 @@
 #include "RSAWrapper.h"
+#include "Tracer.h"
 #include <cryptopp/rsa.h>
 #include <cryptopp/filters.h>
 #include <cryptopp/files.h>
@@ -35,6 +36,7 @@ char* RSAPublicWrapper::getPublicKey(char* keyout, unsigned int length) const
 
 std::string RSAPublicWrapper::encrypt(const std::string& plain)
 {
+	TRACE_SCOPE("rsa.encrypt");
 	std::string cipher;
 	CryptoPP::RSAES_OAEP_SHA_Encryptor e(_publicKey);
 	CryptoPP::StringSource ss(plain, true, new CryptoPP::PK_EncryptorFilter(_rng, e, new CryptoPP::StringSink(cipher)));
@@ -43,6 +45,7 @@ std::string RSAPublicWrapper::encrypt(const std::string& plain)
 
 std::string RSAPublicWrapper::encrypt(const char* plain, unsigned int length)
 {
+	TRACE_SCOPE("rsa.encrypt");
 	std::string cipher;
 	CryptoPP::RSAES_OAEP_SHA_Encryptor e(_publicKey);
 	CryptoPP::StringSource ss(reinterpret_cast<const CryptoPP::byte*>(plain), length, true, new CryptoPP::PK_EncryptorFilter(_rng, e, new CryptoPP::StringSink(cipher)));
@@ -57,12 +60,14 @@ RSAPrivateWrapper::RSAPrivateWrapper()
 
 RSAPrivateWrapper::RSAPrivateWrapper(const char* key, unsigned int length)
 {
+	TRACE_SCOPE("rsa.load_private_key");
 	CryptoPP::StringSource ss(reinterpret_cast<const CryptoPP::byte*>(key), length, true);
 	_privateKey.Load(ss);
 }
 
 RSAPrivateWrapper::RSAPrivateWrapper(const std::string& key)
 {
+	TRACE_SCOPE("rsa.load_private_key");
 	CryptoPP::StringSource ss(key, true);
 	_privateKey.Load(ss);
 }
@@ -103,6 +108,7 @@ char* RSAPrivateWrapper::getPublicKey(char* keyout, unsigned int length) const
 
 std::string RSAPrivateWrapper::decrypt(const std::string& cipher)
 {
+	TRACE_SCOPE("rsa.decrypt");
 	std::string decrypted;
 	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
 	CryptoPP::StringSource ss_cipher(cipher, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
@@ -111,6 +117,7 @@ std::string RSAPrivateWrapper::decrypt(const std::string& cipher)
 
 std::string RSAPrivateWrapper::decrypt(const char* cipher, unsigned int length)
 {
+	TRACE_SCOPE("rsa.decrypt");
 	std::string decrypted;
 	CryptoPP::RSAES_OAEP_SHA_Decryptor d(_privateKey);
 	CryptoPP::StringSource ss_cipher(reinterpret_cast<const CryptoPP::byte*>(cipher), length, true, new CryptoPP::PK_DecryptorFilter(_rng, d, new CryptoPP::StringSink(decrypted)));
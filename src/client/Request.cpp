@@ -1,36 +1,25 @@
 #include "Request.h"
+#include "Tracer.h"
+#include "ProtocolSchema.h"
 #include <stdexcept>
 #include <cstring>
 
-void pack_uint32_le(char* buffer, uint32_t value) {
-	buffer[0] = value & 0xFF;
-	buffer[1] = (value >> 8) & 0xFF;
-	buffer[2] = (value >> 16) & 0xFF;
-	buffer[3] = (value >> 24) & 0xFF;
-}
-
-void pack_uint16_le(char* buffer, uint16_t value) {
-	buffer[0] = value & 0xFF;
-	buffer[1] = (value >> 8) & 0xFF;
-}
-
 
 std::string Request::packHeader(uint32_t payloadSize)
 {
 	_header.payloadSize = payloadSize;
 
-	std::string packed(sizeof(RequestHeader), '\0');
+	std::string packed(RequestHeaderLayout::size + payloadSize, '\0');
 
+	RequestHeaderLayout::encode(&packed[0], _header.clientID, _header.version, _header.code, _header.payloadSize);
 
-	memcpy(&packed[0], _header.clientID.data(), UUID_SIZE);
-
-	packed[16] = _header.version;
-
-	pack_uint16_le(&packed[17], static_cast<uint16_t>(_header.code));
+	return packed;
+}
 
-	pack_uint32_le(&packed[19], _header.payloadSize);
 
-	return packed;
+void Request::setProtocolFlags(uint8_t flags)
+{
+	_header.version = CLIENT_VERSION | flags;
 }
 
 
@@ -49,16 +38,13 @@ RegisterRequest::RegisterRequest(const std::string& username, const std::string&
 
 std::string RegisterRequest::getPackedRequest()
 {
-	std::string payload;
-
-	payload.append(_username);
-	payload.append(CLIENT_NAME_SIZE - _username.length(), '\0');
-
-	payload.append(_publicKey);
+	TRACE_SCOPE("request.pack");
+	std::string packed = packHeader(RegisterPayloadLayout::size);
 
-	std::string header = packHeader((uint32_t)payload.length());
+	RegisterPayloadLayout::encode(&packed[RequestHeaderLayout::size],
+		schema::padded<CLIENT_NAME_SIZE>(_username), schema::padded<PUBLIC_KEY_SIZE>(_publicKey));
 
-	return header + payload;
+	return packed;
 }
 
 
@@ -72,6 +58,7 @@ ClientListRequest::ClientListRequest(const std::array<char, UUID_SIZE>& clientID
 
 std::string ClientListRequest::getPackedRequest()
 {
+	TRACE_SCOPE("request.pack");
 	return packHeader(0);
 }
 
@@ -87,9 +74,10 @@ PublicKeyRequest::PublicKeyRequest(const std::array<char, UUID_SIZE>& clientID,
 
 std::string PublicKeyRequest::getPackedRequest()
 {
-	std::string payload(_targetClientID.data(), UUID_SIZE);
-	std::string header = packHeader((uint32_t)payload.length());
-	return header + payload;
+	TRACE_SCOPE("request.pack");
+	std::string packed = packHeader(PublicKeyPayloadLayout::size);
+	PublicKeyPayloadLayout::encode(&packed[RequestHeaderLayout::size], _targetClientID);
+	return packed;
 }
 
 
@@ -107,20 +95,54 @@ SendMessageRequest::SendMessageRequest(const std::array<char, UUID_SIZE>& client
 
 std::string SendMessageRequest::getPackedRequest()
 {
-	const size_t payloadHeaderSize = UUID_SIZE + sizeof(uint8_t) + sizeof(uint32_t);
-	std::string payload(payloadHeaderSize, '\0');
+	TRACE_SCOPE("request.pack");
+	std::string packed = packHeader((uint32_t)(SendMessagePayloadLayout::size + _content.length()));
+
+	char* payload = &packed[RequestHeaderLayout::size];
+	SendMessagePayloadLayout::encode(payload, _targetClientID, static_cast<uint8_t>(_messageType), (uint32_t)_content.length());
 
-	memcpy(&payload[0], _targetClientID.data(), UUID_SIZE);
+	memcpy(payload + SendMessagePayloadLayout::size, _content.data(), _content.length());
 
-	payload[16] = static_cast<uint8_t>(_messageType);
+	return packed;
+}
 
-	pack_uint32_le(&payload[17], (uint32_t)_content.length());
 
-	payload.append(_content);
+SendMultiMessageRequest::SendMultiMessageRequest(const std::array<char, UUID_SIZE>& clientID, const std::vector<std::array<char, UUID_SIZE>>& targetIDs, MessageType type, const std::string& content)
+{
+	if (targetIDs.empty() || targetIDs.size() > UINT16_MAX) {
+		throw std::runtime_error("Invalid number of recipients for multi-recipient message.");
+	}
+	_header.code = static_cast<uint16_t>(RequestCode::SEND_MULTI_MESSAGE);
+	_header.version = CLIENT_VERSION;
+	_header.clientID = clientID;
 
-	std::string header = packHeader((uint32_t)payload.length());
+	_targetClientIDs = targetIDs;
+	_messageType = type;
+	_content = content;
+}
+
+std::string SendMultiMessageRequest::getPackedRequest()
+{
+	TRACE_SCOPE("request.pack");
+	const size_t payloadSize = MultiRecipientCountLayout::size + _targetClientIDs.size() * MultiRecipientLayout::size
+		+ MultiMessageContentLayout::size + _content.length();
+	std::string packed = packHeader((uint32_t)payloadSize);
+
+	char* payload = &packed[RequestHeaderLayout::size];
+	MultiRecipientCountLayout::encode(payload, (uint16_t)_targetClientIDs.size());
+
+	size_t offset = MultiRecipientCountLayout::size;
+	for (const std::array<char, UUID_SIZE>& targetID : _targetClientIDs) {
+		MultiRecipientLayout::encode(payload + offset, targetID);
+		offset += MultiRecipientLayout::size;
+	}
 
-	return header + payload;
+	MultiMessageContentLayout::encode(payload + offset, static_cast<uint8_t>(_messageType), (uint32_t)_content.length());
+	offset += MultiMessageContentLayout::size;
+
+	memcpy(payload + offset, _content.data(), _content.length());
+
+	return packed;
 }
 
 
@@ -133,5 +155,6 @@ PullMessagesRequest::PullMessagesRequest(const std::array<char, UUID_SIZE>& clie
 
 std::string PullMessagesRequest::getPackedRequest()
 {
+	TRACE_SCOPE("request.pack");
 	return packHeader(0);
 }
\ No newline at end of file
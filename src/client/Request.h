@@ -4,25 +4,26 @@
 #include <array>
 #include "Protocol.h"
 
-#pragma pack(push, 1)
 struct RequestHeader {
 	std::array<char, UUID_SIZE> clientID;
 	uint8_t  version;
 	uint16_t code;
 	uint32_t payloadSize;
 };
-#pragma pack(pop)
 
 class Request
 {
 protected:
 	RequestHeader _header;
 
+	// returns a buffer sized for header + payload with the header already encoded
 	std::string packHeader(uint32_t payloadSize);
 
 public:
 	virtual ~Request() = default;
 
+	void setProtocolFlags(uint8_t flags);
+
 	virtual std::string getPackedRequest() = 0;
 };
 
@@ -66,6 +67,18 @@ public:
 	virtual std::string getPackedRequest() override;
 };
 
+class SendMultiMessageRequest : public Request
+{
+private:
+	std::vector<std::array<char, UUID_SIZE>> _targetClientIDs;
+	MessageType _messageType;
+	std::string _content;
+
+public:
+	SendMultiMessageRequest(const std::array<char, UUID_SIZE>& clientID, const std::vector<std::array<char, UUID_SIZE>>& targetIDs, MessageType type, const std::string& content);
+	virtual std::string getPackedRequest() override;
+};
+
 class PullMessagesRequest : public Request
 {
 public:
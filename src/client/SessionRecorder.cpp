@@ -0,0 +1,121 @@
+#include "SessionRecorder.h"
+#include "ProtocolSchema.h"
+#include <stdexcept>
+#include <cstring>
+
+static const char CAPTURE_MAGIC[8] = { 'M', 'U', 'C', 'A', 'P', 'T', '0', '1' };
+
+using CaptureRecordLayout = schema::Layout<schema::UInt<uint8_t>, schema::UInt<uint32_t>, schema::UInt<uint64_t>, schema::UInt<uint32_t>>;
+
+
+SessionRecorder::SessionRecorder() : _active(false), _nextConnectionID(1), _file(nullptr)
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	stop();
+}
+
+SessionRecorder& SessionRecorder::instance()
+{
+	static SessionRecorder recorder;
+	return recorder;
+}
+
+void SessionRecorder::start(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file) {
+		throw std::runtime_error("Error: A session is already being recorded to " + _path + ".");
+	}
+	if (fopen_s(&_file, path.c_str(), "wb") != 0) {
+		_file = nullptr;
+		throw std::runtime_error("Error: Could not open " + path + " for writing.");
+	}
+	if (fwrite(CAPTURE_MAGIC, 1, sizeof(CAPTURE_MAGIC), _file) != sizeof(CAPTURE_MAGIC)) {
+		fclose(_file);
+		_file = nullptr;
+		throw std::runtime_error("Error: Failed to write to " + path + ".");
+	}
+
+	_path = path;
+	_start = std::chrono::steady_clock::now();
+	_active = true;
+}
+
+void SessionRecorder::stop()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_active = false;
+	if (_file) {
+		fclose(_file);
+		_file = nullptr;
+	}
+}
+
+uint32_t SessionRecorder::nextConnectionID()
+{
+	return _nextConnectionID.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SessionRecorder::writeRecordHeader(CaptureDirection direction, uint32_t connectionID, size_t length)
+{
+	uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count());
+
+	char header[CaptureRecordLayout::size];
+	CaptureRecordLayout::encode(header, static_cast<uint8_t>(direction), connectionID, elapsed, static_cast<uint32_t>(length));
+	fwrite(header, 1, sizeof(header), _file);
+}
+
+void SessionRecorder::record(CaptureDirection direction, uint32_t connectionID, const char* data, size_t length)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_file) {
+		return;
+	}
+	writeRecordHeader(direction, connectionID, length);
+	fwrite(data, 1, length, _file);
+}
+
+void SessionRecorder::record(CaptureDirection direction, uint32_t connectionID, const char* header, size_t headerLength, const std::string& payload)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_file) {
+		return;
+	}
+	writeRecordHeader(direction, connectionID, headerLength + payload.length());
+	fwrite(header, 1, headerLength, _file);
+	fwrite(payload.data(), 1, payload.length(), _file);
+}
+
+std::vector<CaptureRecord> SessionRecorder::load(const std::string& path)
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, path.c_str(), "rb") != 0) {
+		throw std::runtime_error("Error: Could not open capture " + path + ".");
+	}
+
+	char magic[sizeof(CAPTURE_MAGIC)];
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) {
+		fclose(file);
+		throw std::runtime_error("Error: " + path + " is not a MessageU capture.");
+	}
+
+	std::vector<CaptureRecord> records;
+	char header[CaptureRecordLayout::size];
+	while (fread(header, 1, sizeof(header), file) == sizeof(header))
+	{
+		auto [direction, connectionID, timestampUs, length] = CaptureRecordLayout::decode(header);
+
+		std::string data(length, '\0');
+		if (length > 0 && fread(&data[0], 1, length, file) != length) {
+			// the client was killed mid-write; keep everything before the torn record
+			break;
+		}
+		records.push_back({ static_cast<CaptureDirection>(direction), connectionID, timestampUs, std::move(data) });
+	}
+
+	fclose(file);
+	return records;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+enum class CaptureDirection : uint8_t
+{
+	OUTBOUND = 1,
+	INBOUND = 2
+};
+
+struct CaptureRecord {
+	CaptureDirection direction;
+	uint32_t connectionID;
+	uint64_t timestampUs;
+	std::string data;
+};
+
+// Writes every request and response that passes through a NetworkManager to a binary capture:
+// an 8 byte magic, then records of direction(1) + connection(4) + microseconds since start(8)
+// + length(4) followed by the exact bytes that went over the wire.
+class SessionRecorder
+{
+public:
+	static SessionRecorder& instance();
+
+	void start(const std::string& path);
+
+	void stop();
+
+	bool active() const
+	{
+		return _active.load(std::memory_order_relaxed);
+	}
+
+	uint32_t nextConnectionID();
+
+	void record(CaptureDirection direction, uint32_t connectionID, const char* data, size_t length);
+
+	void record(CaptureDirection direction, uint32_t connectionID, const char* header, size_t headerLength, const std::string& payload);
+
+	static std::vector<CaptureRecord> load(const std::string& path);
+
+private:
+	std::atomic<bool> _active;
+	std::atomic<uint32_t> _nextConnectionID;
+	std::mutex _mutex;
+	FILE* _file;
+	std::string _path;
+	std::chrono::steady_clock::time_point _start;
+
+	SessionRecorder();
+	~SessionRecorder();
+	SessionRecorder(const SessionRecorder&) = delete;
+	SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+	void writeRecordHeader(CaptureDirection direction, uint32_t connectionID, size_t length);
+};
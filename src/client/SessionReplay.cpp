@@ -0,0 +1,397 @@
+#include "NetworkManager.h"
+#include "ClientConfig.h"
+#include "SessionRecorder.h"
+#include "FakeServer.h"
+#include "ProtocolSchema.h"
+#include "CompressionWrapper.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+// Plays a capture written by the client's --record mode against a server. Each recorded
+// connection gets its own connection and thread; sends keep their original spacing, divided
+// by --speed. Every response is timed and compared with the recorded one.
+
+struct ReplayOptions {
+	std::string capturePath;
+	std::string host;
+	int port = 0;
+	double speed = 1.0;	// 0 replays as fast as the server answers
+	bool fakeServer = false;
+	bool showUsage = false;
+};
+
+struct RecordedSend {
+	uint64_t timestampUs;
+	std::string data;
+	std::vector<uint16_t> requestCodes;
+	std::vector<uint16_t> recordedResponseCodes;
+	std::vector<int64_t> recordedLatencyUs;	// -1 when the capture has no response for it
+};
+
+struct ReplayedRequest {
+	uint16_t requestCode;
+	int64_t recordedLatencyUs;
+	int64_t replayedLatencyUs;
+	bool codeMatches;
+	bool failed;
+};
+
+static void printUsage()
+{
+	std::cout << "usage: replay <capture> [--server host:port | --fake] [--speed factor]" << std::endl;
+	std::cout << "--speed 1 keeps the recorded pacing, 10 replays ten times faster, 0 sends as fast as possible" << std::endl;
+	std::cout << "--fake first stores every client the capture refers to under its recorded id, with the names" << std::endl;
+	std::cout << "and public keys the capture shows; a real server must already know them" << std::endl;
+}
+
+static ReplayOptions parseOptions(int argc, char* argv[])
+{
+	ReplayOptions options;
+	bool haveServer = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			options.showUsage = true;
+			return options;
+		}
+		else if (arg == "--fake") {
+			options.fakeServer = true;
+		}
+		else if (arg == "--server" || arg == "--speed") {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Error: Missing value for option '" + arg + "'.");
+			}
+			std::string value = argv[++i];
+			if (arg == "--speed") {
+				options.speed = std::stod(value);
+				continue;
+			}
+			size_t colonPos = value.find(':');
+			if (colonPos == std::string::npos) {
+				throw std::runtime_error("Error: --server expects host:port.");
+			}
+			options.host = value.substr(0, colonPos);
+			options.port = std::stoi(value.substr(colonPos + 1));
+			haveServer = true;
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			throw std::runtime_error("Error: Unknown command line option '" + arg + "'.");
+		}
+		else {
+			options.capturePath = arg;
+		}
+	}
+
+	if (options.capturePath.empty()) {
+		printUsage();
+		throw std::runtime_error("Error: No capture file given.");
+	}
+	if (!haveServer && !options.fakeServer) {
+		std::pair<std::string, int> server = ClientConfig::loadServerInfo();
+		options.host = server.first;
+		options.port = server.second;
+	}
+	return options;
+}
+
+// groups the capture per connection and pairs every request with its recorded response
+static std::map<uint32_t, std::vector<RecordedSend>> buildSessions(const std::vector<CaptureRecord>& records)
+{
+	std::map<uint32_t, std::vector<RecordedSend>> sessions;
+	std::map<uint32_t, std::pair<size_t, size_t>> nextResponse;	// per connection: send index, request index
+
+	for (const CaptureRecord& record : records)
+	{
+		std::vector<RecordedSend>& sends = sessions[record.connectionID];
+
+		if (record.direction == CaptureDirection::OUTBOUND)
+		{
+			RecordedSend send{ record.timestampUs, record.data, {}, {}, {} };
+			schema::Reader reader(record.data);
+			while (reader.remaining() >= RequestHeaderLayout::size) {
+				auto [clientID, version, code, payloadSize] = reader.read<RequestHeaderLayout>();
+				reader.bytes(std::min<size_t>(payloadSize, reader.remaining()));
+				send.requestCodes.push_back(code);
+				send.recordedResponseCodes.push_back(0);
+				send.recordedLatencyUs.push_back(-1);
+			}
+			sends.push_back(std::move(send));
+			continue;
+		}
+
+		if (record.data.size() < ResponseHeaderLayout::size) {
+			continue;
+		}
+		auto [version, code, payloadSize] = ResponseHeaderLayout::decode(record.data.data());
+
+		// responses come back in request order, so the next unanswered request owns this one
+		auto& [sendIndex, requestIndex] = nextResponse[record.connectionID];
+		while (sendIndex < sends.size() && requestIndex >= sends[sendIndex].requestCodes.size()) {
+			sendIndex++;
+			requestIndex = 0;
+		}
+		if (sendIndex >= sends.size()) {
+			continue;
+		}
+		RecordedSend& send = sends[sendIndex];
+		send.recordedResponseCodes[requestIndex] = code;
+		send.recordedLatencyUs[requestIndex] = static_cast<int64_t>(record.timestampUs - send.timestampUs);
+		requestIndex++;
+	}
+
+	for (auto it = sessions.begin(); it != sessions.end();) {
+		it = it->second.empty() ? sessions.erase(it) : std::next(it);
+	}
+	return sessions;
+}
+
+// a fresh fake server knows none of the recorded ids, so every 602-605 would replay as an error;
+// it is given every client the capture refers to, with what the responses revealed about them
+static void seedFakeServer(FakeServer& server, const std::vector<CaptureRecord>& records)
+{
+	struct Identity {
+		std::string name;
+		std::string publicKey;
+		bool registeredInCapture = false;
+	};
+	std::map<std::array<char, UUID_SIZE>, Identity> identities;
+	std::map<uint32_t, std::deque<std::pair<uint16_t, std::string>>> unanswered;	// per connection: code, REGISTER payload
+	const std::array<char, UUID_SIZE> noClient = {};
+
+	for (const CaptureRecord& record : records)
+	{
+		try {
+			if (record.direction == CaptureDirection::OUTBOUND)
+			{
+				schema::Reader reader(record.data);
+				while (reader.remaining() >= RequestHeaderLayout::size) {
+					auto [clientID, version, code, payloadSize] = reader.read<RequestHeaderLayout>();
+					std::string_view payload = reader.bytes(std::min<size_t>(payloadSize, reader.remaining()));
+					unanswered[record.connectionID].emplace_back(code, code == static_cast<uint16_t>(RequestCode::REGISTER) ? std::string(payload) : "");
+					if (clientID != noClient) {
+						identities[clientID];
+					}
+
+					schema::Reader body(payload);
+					if (code == static_cast<uint16_t>(RequestCode::PUBLIC_KEY)) {
+						auto [targetID] = body.read<PublicKeyPayloadLayout>();
+						identities[targetID];
+					}
+					else if (code == static_cast<uint16_t>(RequestCode::SEND_MESSAGE)) {
+						auto [targetID, type, contentSize] = body.read<SendMessagePayloadLayout>();
+						identities[targetID];
+					}
+					else if (code == static_cast<uint16_t>(RequestCode::SEND_MULTI_MESSAGE)) {
+						auto [count] = body.read<MultiRecipientCountLayout>();
+						for (uint16_t i = 0; i < count; i++) {
+							auto [targetID] = body.read<MultiRecipientLayout>();
+							identities[targetID];
+						}
+					}
+				}
+				continue;
+			}
+
+			std::deque<std::pair<uint16_t, std::string>>& pending = unanswered[record.connectionID];
+			if (record.data.size() < ResponseHeaderLayout::size || pending.empty()) {
+				continue;
+			}
+			auto [requestCode, registerPayload] = pending.front();
+			pending.pop_front();
+
+			auto [version, code, payloadSize] = ResponseHeaderLayout::decode(record.data.data());
+			std::string payload = record.data.substr(ResponseHeaderLayout::size);
+			if (version & PROTOCOL_FLAG_COMPRESSION) {
+				payload = CompressionWrapper::decompress(payload);
+			}
+
+			schema::Reader reader(payload);
+			if (code == 2100 && requestCode == static_cast<uint16_t>(RequestCode::REGISTER)) {
+				auto [uuid] = reader.read<RegisterSuccessLayout>();
+				auto [name, publicKey] = schema::Reader(registerPayload).read<RegisterPayloadLayout>();
+				Identity& identity = identities[uuid];
+				identity.name = schema::unpadded(name);
+				identity.publicKey.assign(publicKey.data(), PUBLIC_KEY_SIZE);
+				identity.registeredInCapture = true;
+			}
+			else if (code == 2101) {
+				while (!reader.empty()) {
+					auto [uuid, name] = reader.read<ClientListRecordLayout>();
+					identities[uuid].name = schema::unpadded(name);
+				}
+			}
+			else if (code == 2102) {
+				auto [uuid, publicKey] = reader.read<PublicKeyResponseLayout>();
+				identities[uuid].publicKey.assign(publicKey.data(), PUBLIC_KEY_SIZE);
+			}
+		}
+		catch (const std::runtime_error&) {
+			// a truncated record only costs what it would have told us
+		}
+	}
+
+	for (const auto& [uuid, identity] : identities) {
+		server.addClient(uuid, identity.name, identity.publicKey, !identity.registeredInCapture);
+	}
+}
+
+static void replaySession(const ReplayOptions& options, const std::vector<RecordedSend>& sends,
+	std::chrono::steady_clock::time_point start, uint64_t captureStartUs, std::vector<ReplayedRequest>& results)
+{
+	NetworkManager net;
+
+	for (const RecordedSend& send : sends)
+	{
+		if (options.speed > 0) {
+			auto offset = std::chrono::microseconds(static_cast<int64_t>((send.timestampUs - captureStartUs) / options.speed));
+			std::this_thread::sleep_until(start + offset);
+		}
+
+		size_t answered = 0;
+		try {
+			if (!net.is_connected()) {
+				net.connect_to_server(options.host, options.port);
+			}
+
+			auto sentAt = std::chrono::steady_clock::now();
+			net.send_data(send.data);
+			for (size_t i = 0; i < send.requestCodes.size(); i++) {
+				ServerResponse res = net.receive_response();
+				auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt);
+				results.push_back({ send.requestCodes[i], send.recordedLatencyUs[i], static_cast<int64_t>(elapsed.count()),
+					res.code == send.recordedResponseCodes[i], false });
+				answered++;
+			}
+		}
+		catch (const std::exception&) {
+			for (size_t i = answered; i < send.requestCodes.size(); i++) {
+				results.push_back({ send.requestCodes[i], send.recordedLatencyUs[i], -1, false, true });
+			}
+			net.disconnect_server();
+		}
+	}
+}
+
+static double percentileMs(std::vector<int64_t> values, double p)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+	return values[rank] / 1000.0;
+}
+
+static void printReport(const std::vector<ReplayedRequest>& results, double recordedSeconds, double replaySeconds)
+{
+	std::map<uint16_t, std::vector<const ReplayedRequest*>> byCode;
+	for (const ReplayedRequest& result : results) {
+		byCode[result.requestCode].push_back(&result);
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "recorded duration " << recordedSeconds << "s, replayed in " << replaySeconds << "s" << std::endl;
+	std::cout << std::left << std::setw(8) << "code" << std::right << std::setw(8) << "count" << std::setw(10) << "mismatch" << std::setw(8) << "failed"
+		<< std::setw(12) << "rec p50" << std::setw(12) << "replay p50" << std::setw(12) << "rec p99" << std::setw(12) << "replay p99"
+		<< std::setw(14) << "mean delta" << std::endl;
+
+	for (const auto& [code, requests] : byCode)
+	{
+		std::vector<int64_t> recorded;
+		std::vector<int64_t> replayed;
+		size_t mismatches = 0;
+		size_t failures = 0;
+		double deltaSum = 0;
+		size_t deltaCount = 0;
+
+		for (const ReplayedRequest* request : requests) {
+			if (request->failed) {
+				failures++;
+				continue;
+			}
+			if (!request->codeMatches) {
+				mismatches++;
+			}
+			replayed.push_back(request->replayedLatencyUs);
+			if (request->recordedLatencyUs >= 0) {
+				recorded.push_back(request->recordedLatencyUs);
+				deltaSum += static_cast<double>(request->replayedLatencyUs - request->recordedLatencyUs);
+				deltaCount++;
+			}
+		}
+
+		std::cout << std::left << std::setw(8) << code << std::right << std::setw(8) << requests.size() << std::setw(10) << mismatches << std::setw(8) << failures
+			<< std::setw(12) << percentileMs(recorded, 0.50) << std::setw(12) << percentileMs(replayed, 0.50)
+			<< std::setw(12) << percentileMs(recorded, 0.99) << std::setw(12) << percentileMs(replayed, 0.99)
+			<< std::setw(14) << (deltaCount ? deltaSum / deltaCount / 1000.0 : 0.0) << std::endl;
+	}
+	std::cout << "latencies in ms; mismatch counts responses whose code differs from the capture" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		ReplayOptions options = parseOptions(argc, argv);
+		if (options.showUsage) {
+			printUsage();
+			return 0;
+		}
+
+		std::vector<CaptureRecord> records = SessionRecorder::load(options.capturePath);
+		if (records.empty()) {
+			throw std::runtime_error("Error: The capture is empty.");
+		}
+		std::map<uint32_t, std::vector<RecordedSend>> sessions = buildSessions(records);
+
+		FakeServer fakeServer;
+		if (options.fakeServer) {
+			seedFakeServer(fakeServer, records);
+			options.host = "127.0.0.1";
+			options.port = fakeServer.start();
+		}
+
+		std::cout << "Replaying " << records.size() << " records on " << sessions.size() << " connection(s) against "
+			<< options.host << ":" << options.port << "..." << std::endl;
+
+		uint64_t captureStartUs = records.front().timestampUs;
+		uint64_t captureEndUs = records.back().timestampUs;
+		std::vector<std::vector<ReplayedRequest>> perSession(sessions.size());
+		std::vector<std::thread> threads;
+
+		auto start = std::chrono::steady_clock::now();
+		size_t index = 0;
+		for (const auto& [connectionID, sends] : sessions) {
+			threads.emplace_back(replaySession, std::cref(options), std::cref(sends), start, captureStartUs, std::ref(perSession[index++]));
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		double replaySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<ReplayedRequest> results;
+		for (const std::vector<ReplayedRequest>& session : perSession) {
+			results.insert(results.end(), session.begin(), session.end());
+		}
+		printReport(results, (captureEndUs - captureStartUs) / 1e6, replaySeconds);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Fatal Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+private:
+	static const size_t MASK = Capacity - 1;
+
+	std::array<T, Capacity> _slots;
+
+	// kept on separate cache lines so the two threads don't invalidate each other's index
+	alignas(64) std::atomic<size_t> _head;	// next slot to read, written by the consumer only
+	alignas(64) std::atomic<size_t> _tail;	// next slot to write, written by the producer only
+
+public:
+	SpscQueue() : _head(0), _tail(0) {}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	bool tryPush(T&& value)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		_slots[tail & MASK] = std::move(value);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T& value)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = std::move(_slots[head & MASK]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool full() const
+	{
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire) == Capacity;
+	}
+};
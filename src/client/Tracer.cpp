@@ -0,0 +1,98 @@
+#include "Tracer.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+std::atomic<bool> Tracer::_enabled(false);
+
+namespace
+{
+	struct TraceEvent {
+		const char* name;
+		uint64_t startNs;
+		uint64_t durationNs;
+	};
+
+	struct ThreadBuffer {
+		uint32_t threadID;
+		std::atomic<uint64_t> written{ 0 };
+		std::vector<TraceEvent> events;
+
+		ThreadBuffer(uint32_t id) : threadID(id), events(Tracer::EVENTS_PER_THREAD) {}
+	};
+
+	// buffers are owned here rather than by the thread, so spans from threads that have
+	// already exited (sender, receiver, workers) are still there at export time
+	std::mutex g_buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+	thread_local ThreadBuffer* t_buffer = nullptr;
+
+	ThreadBuffer* threadBuffer()
+	{
+		if (!t_buffer) {
+			std::lock_guard<std::mutex> lock(g_buffersMutex);
+			g_buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(g_buffers.size() + 1)));
+			t_buffer = g_buffers.back().get();
+		}
+		return t_buffer;
+	}
+
+	const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+}
+
+void Tracer::enable()
+{
+	_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable()
+{
+	_enabled.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count());
+}
+
+void Tracer::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+	ThreadBuffer* buffer = threadBuffer();
+	uint64_t index = buffer->written.load(std::memory_order_relaxed);
+	buffer->events[index % EVENTS_PER_THREAD] = { name, startNs, endNs - startNs };
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::writeChromeTrace(const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Error: Could not open trace file '" + path + "' for writing.");
+	}
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	file.setf(std::ios::fixed);
+	file.precision(3);
+
+	bool first = true;
+	std::lock_guard<std::mutex> lock(g_buffersMutex);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : g_buffers)
+	{
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+
+		for (uint64_t i = begin; i < written; i++)
+		{
+			const TraceEvent& event = buffer->events[i % EVENTS_PER_THREAD];
+			file << (first ? "\n" : ",\n")
+				<< "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID
+				<< ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Optional span recorder. Each thread appends complete begin/end spans to its own ring buffer,
+// so recording never takes a lock; when tracing is off a span costs one relaxed atomic load.
+// The buffers are exported as Chrome trace JSON (chrome://tracing, Perfetto, speedscope).
+class Tracer
+{
+public:
+	static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+	static bool enabled()
+	{
+		return _enabled.load(std::memory_order_relaxed);
+	}
+
+	static void enable();
+
+	static void disable();
+
+	static uint64_t now();
+
+	// name must be a string literal or otherwise outlive the export
+	static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+	static void writeChromeTrace(const std::string& path);
+
+private:
+	static std::atomic<bool> _enabled;
+};
+
+class TraceScope
+{
+private:
+	const char* _name;
+	uint64_t _start;
+
+public:
+	explicit TraceScope(const char* name) : _name(nullptr), _start(0)
+	{
+		if (Tracer::enabled()) {
+			_name = name;
+			_start = Tracer::now();
+		}
+	}
+
+	~TraceScope()
+	{
+		if (_name) {
+			Tracer::record(_name, _start, Tracer::now());
+		}
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
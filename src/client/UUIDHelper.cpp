@@ -0,0 +1,27 @@
+#include "UUIDHelper.h"
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+
+std::string UUIDHelper::getHexFromUUID(const std::string& uuid_bytes) {
+	std::stringstream ss;
+	ss << std::hex << std::setfill('0');
+	for (unsigned char c : uuid_bytes) {
+		ss << std::setw(2) << static_cast<int>(c);
+	}
+	return ss.str();
+}
+
+std::string UUIDHelper::getUUIDFromHex(const std::string& hex_string) {
+	std::string bytes;
+	if (hex_string.length() != 32) {
+		throw std::runtime_error("Invalid hex UUID string length.");
+	}
+	for (unsigned int i = 0; i < hex_string.length(); i += 2) {
+		std::string byteString = hex_string.substr(i, 2);
+		char byte = static_cast<char>(std::strtol(byteString.c_str(), NULL, 16));
+		bytes.push_back(byte);
+	}
+	return bytes;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+
+class UUIDHelper
+{
+public:
+	static std::string getHexFromUUID(const std::string& uuid_bytes);
+	static std::string getUUIDFromHex(const std::string& hex_string);
+};
@@ -0,0 +1,42 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threadCount) : _stopping(false)
+{
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+	for (size_t i = 0; i < threadCount; i++) {
+		_workers.emplace_back(&WorkerPool::workerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wakeup.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+void WorkerPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeup.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+			if (_stopping && _tasks.empty()) {
+				return;
+			}
+			task = std::move(_tasks.front());
+			_tasks.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+class WorkerPool
+{
+private:
+	std::vector<std::thread> _workers;
+	std::queue<std::function<void()>> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	bool _stopping;
+
+	void workerLoop();
+
+public:
+	WorkerPool(size_t threadCount = std::thread::hardware_concurrency());
+	~WorkerPool();
+
+	template <typename Task>
+	auto submit(Task task) -> std::future<decltype(task())>
+	{
+		auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+		std::future<decltype(task())> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tasks.push([packaged] { (*packaged)(); });
+		}
+		_wakeup.notify_one();
+		return result;
+	}
+};
@@ -1,25 +1,80 @@
 #include "MessageUClient.h"
+#include "Tracer.h"
+#include "SessionRecorder.h"
+#include "BatchRunner.h"
 #include <iostream>
+#include <fstream>
+#include <stdexcept>
 
-int main()
+static size_t runBatch(MessageUClient& client, const std::string& path)
 {
+	if (path == "-") {
+		return BatchRunner(client, std::cin, std::cout).run();
+	}
+
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("Error: Could not open batch file " + path + ".");
+	}
+	return BatchRunner(client, file, std::cout).run();
+}
+
+static void pauseBeforeExit(bool batchMode)
+{
+	// nobody is at the console in batch mode, and stdin may be the command stream
+	if (batchMode) {
+		return;
+	}
+	std::cerr << "Press Enter to exit." << std::endl;
+	std::cin.get();
+}
+
+int main(int argc, char* argv[])
+{
+	bool batchMode = false;
 	try
 	{
-		MessageUClient client;
-		client.run();    
+		ClientOptions options = ClientConfig::parseOptions(argc, argv);
+		batchMode = !options.batchFile.empty();
+		if (!options.traceFile.empty()) {
+			Tracer::enable();
+		}
+		if (!options.recordFile.empty()) {
+			SessionRecorder::instance().start(options.recordFile);
+		}
+
+		size_t failures = 0;
+		{
+			MessageUClient client(options);
+			if (options.batchFile.empty()) {
+				client.run();
+			}
+			else {
+				failures = runBatch(client, options.batchFile);
+			}
+		}
+
+		SessionRecorder::instance().stop();
+
+		// written after the client is gone so the background threads' spans are complete
+		if (!options.traceFile.empty()) {
+			Tracer::writeChromeTrace(options.traceFile);
+			std::cerr << "Trace written to " << options.traceFile << std::endl;
+		}
+		if (failures > 0) {
+			return 1;
+		}
 	}
 	catch (const std::exception& e)
 	{
 		std::cerr << "Fatal Error: " << e.what() << std::endl;
-		std::cerr << "Press Enter to exit." << std::endl;
-		std::cin.get();
+		pauseBeforeExit(batchMode);
 		return 1;
 	}
 	catch (...)
 	{
 		std::cerr << "An unknown fatal error occurred." << std::endl;
-		std::cerr << "Press Enter to exit." << std::endl;
-		std::cin.get();
+		pauseBeforeExit(batchMode);
 		return 2;
 	}
 
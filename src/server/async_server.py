@@ -0,0 +1,186 @@
+from utils.config_loader import ConfigLoader
+from utils.logger import ServerLogger
+from handler import RequestHandler
+from protocol.header import RequestHeader
+from protocol.builder import ResponseBuilder
+from protocol.response_writer import ResponseWriter, FileSegment
+from storage.engine import StorageEngine
+from storage.sweeper import ExpirySweeper
+from concurrent.futures import ThreadPoolExecutor
+from collections import deque
+import asyncio
+
+
+class ConnectionProtocol(asyncio.BufferedProtocol):
+    """One client connection on the event loop.
+
+    Bytes are received straight into a per-connection buffer that starts small, so idle
+    connections stay cheap, and grows only while a large request is being read. Complete
+    requests are handled one at a time on the worker pool, which keeps responses in
+    request order for pipelining clients.
+    """
+
+    INITIAL_BUFFER_SIZE = RequestHandler.BUFFER_SIZE
+    MAX_PENDING = 64  # parsed requests held before reading is paused
+
+    def __init__(self, server: "AsyncServer"):
+        self.server = server
+        self.logger = server.logger
+        self.transport = None
+        self.addr = None
+        self.handler = None
+        self._buffer = bytearray(self.INITIAL_BUFFER_SIZE)
+        self._used = 0
+        self._pending = deque()
+        self._processing = False
+        self._reading_paused = False
+
+    def connection_made(self, transport):
+        self.transport = transport
+        self.addr = transport.get_extra_info("peername")
+        self.handler = RequestHandler(addr=self.addr)
+        self.server.connection_count += 1
+        self.logger.info(f"New connection from {self.addr}")
+
+    def connection_lost(self, exc):
+        self.server.connection_count -= 1
+        self._pending.clear()
+        self.logger.info(f"Connection closed: {self.addr}")
+
+    def get_buffer(self, sizehint: int):
+        if self._used == len(self._buffer):
+            self._resize(len(self._buffer) * 2)
+        return memoryview(self._buffer)[self._used:]
+
+    def buffer_updated(self, nbytes: int):
+        self._used += nbytes
+        self._parse_requests()
+        if self._pending and not self._processing:
+            self._processing = True
+            asyncio.get_running_loop().create_task(self._process_pending())
+
+    def _resize(self, size: int):
+        # the transport may still hold a view of the old buffer, so it is replaced rather than resized
+        buffer = bytearray(size)
+        buffer[:self._used] = memoryview(self._buffer)[:self._used]
+        self._buffer = buffer
+
+    def _parse_requests(self):
+        offset = 0
+        with memoryview(self._buffer) as view:
+            while self._used - offset >= RequestHeader.SIZE:
+                try:
+                    header = RequestHeader.from_bytes(bytes(view[offset:offset + RequestHeader.SIZE]))
+                except Exception as parse_err:
+                    self.logger.error(f"Malformed request from {self.addr}: {parse_err}")
+                    self.transport.write(ResponseBuilder.build_error())
+                    self.transport.close()
+                    return
+
+                if header.payload_size > RequestHeader.MAX_PAYLOAD_SIZE:
+                    self.logger.error(f"Request from {self.addr} declares a {header.payload_size} byte payload; closing")
+                    self.transport.write(ResponseBuilder.build_error())
+                    self.transport.close()
+                    return
+
+                end = offset + RequestHeader.SIZE + header.payload_size
+                if end > self._used:
+                    break
+                self._pending.append((header, bytes(view[offset + RequestHeader.SIZE:end])))
+                offset = end
+
+            if offset:
+                remaining = self._used - offset
+                view[:remaining] = view[offset:self._used]
+                self._used = remaining
+
+        # a large request grows the buffer in get_buffer as its bytes arrive, never from the declared size alone
+        if self._used < RequestHeader.SIZE and len(self._buffer) > self.INITIAL_BUFFER_SIZE:
+            # give back the memory of a large request once it is consumed
+            self._resize(self.INITIAL_BUFFER_SIZE)
+
+        if len(self._pending) >= self.MAX_PENDING and not self._reading_paused:
+            self._reading_paused = True
+            self.transport.pause_reading()
+
+    async def _process_pending(self):
+        loop = asyncio.get_running_loop()
+        try:
+            while self._pending:
+                header, payload = self._pending.popleft()
+                response = await loop.run_in_executor(self.server.workers, self.handler.handle, header, payload)
+                if isinstance(response, ResponseWriter):
+                    if not await self._write_response(loop, response):
+                        return
+                elif self.transport.is_closing():
+                    return
+                elif response:
+                    self.transport.write(response)
+                if self._reading_paused and len(self._pending) < self.MAX_PENDING // 2:
+                    self._reading_paused = False
+                    self.transport.resume_reading()
+        finally:
+            self._processing = False
+
+    async def _write_response(self, loop, response: ResponseWriter) -> bool:
+        """Buffers go through the transport; files through loop.sendfile, which uses os.sendfile when it can."""
+        try:
+            for run in response.runs():
+                if self.transport.is_closing():
+                    return False
+                if isinstance(run, FileSegment):
+                    await loop.sendfile(self.transport, run.open(), 0, run.size)
+                else:
+                    self.transport.writelines(run)
+            return True
+        except (OSError, RuntimeError) as e:
+            # OSError also covers a blob file that can't be opened once the header is out
+            self.logger.warning(f"Failed sending response to {self.addr}: {e}")
+            self.transport.close()
+            return False
+        finally:
+            response.close()
+
+
+class AsyncServer:
+    """Event-loop server: one loop thread for all sockets, handlers on a bounded worker pool."""
+
+    DEFAULT_BACKLOG = 1024
+    DEFAULT_WORKERS = 16
+
+    def __init__(self, backlog: int = DEFAULT_BACKLOG, workers: int = DEFAULT_WORKERS, shards: int = 1,
+                 message_ttl=None, sweep_interval: float = ExpirySweeper.DEFAULT_INTERVAL):
+        self.config = ConfigLoader()
+        self.logger = ServerLogger(self.config.log_path)
+        self.host = "0.0.0.0"
+        self.port = self.config.port
+        self.backlog = backlog
+        self.worker_count = workers
+        self.storage = StorageEngine.instance(self.config.db_path, shards, message_ttl)
+        self.sweeper = ExpirySweeper(self.storage, sweep_interval) if sweep_interval > 0 else None
+        self.workers = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="Worker")
+        self.connection_count = 0
+
+    async def _serve(self):
+        server = await asyncio.get_running_loop().create_server(
+            lambda: ConnectionProtocol(self), self.host, self.port, backlog=self.backlog, reuse_address=True)
+        self.logger.info(f"Server (v{self.config.version}) started on port {self.port} "
+                         f"(event loop, backlog {self.backlog}, {self.worker_count} workers, "
+                         f"{len(self.storage.shards)} message shard(s))")
+        self.logger.separator()
+        self.logger.info("Server is running and waiting for connections.")
+        async with server:
+            await server.serve_forever()
+
+    def run(self):
+        if self.sweeper:
+            self.sweeper.start()
+        try:
+            asyncio.run(self._serve())
+        except KeyboardInterrupt:
+            self.logger.info("KeyboardInterrupt received. Shutting down server gracefully...")
+        finally:
+            self.workers.shutdown(wait=True)
+            if self.sweeper:
+                self.sweeper.close()
+            self.storage.close()
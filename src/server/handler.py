@@ -3,7 +3,8 @@ import uuid
 
 from protocol.header import RequestHeader
 from protocol.builder import ResponseBuilder
-from protocol.enums import RequestCode, MessageType
+from protocol.response_writer import ResponseWriter
+from protocol.enums import RequestCode, MessageType, MessageFlag, ProtocolFlag
 from protocol.payload import PayloadParser  # Ensure this parser is used
 from storage.db_manager import DatabaseManager
 from models.client import ClientRecord
@@ -13,39 +14,51 @@ from utils.logger import ServerLogger
 
 class RequestHandler:
     BUFFER_SIZE = 4096
+    # the client accepts a pull this large, or a single message of any size on its own
+    PULL_SIZE_LIMIT = RequestHeader.MAX_PAYLOAD_SIZE
 
-    def __init__(self, conn: socket.socket, addr):
+    def __init__(self, conn: socket.socket = None, addr=None):
         self.conn = conn
         self.addr = addr
         self.db = DatabaseManager("defensive.db")
         self.logger = ServerLogger()
+        self._header_buffer = bytearray(RequestHeader.SIZE)
+        self._sampled = True
 
     def process(self):
+        """Blocking request loop for the thread-per-connection server."""
         try:
             while True:
-                # Per protocol spec, request header is 23 bytes
-                header_data = self._recv_exact(23)
-                if not header_data:
+                try:
+                    header_data = self._recv_exact(RequestHeader.SIZE, self._header_buffer)
+                except ConnectionResetError:
                     self.logger.info(f"Client {self.addr} disconnected.")
                     break
 
                 try:
                     header = RequestHeader.from_bytes(header_data)
-                    payload = self._read_payload(header) # Pass header object
-
                 except Exception as parse_err:
                     self.logger.error(f"Malformed request from {self.addr}: {parse_err}")
                     self.conn.sendall(ResponseBuilder.build_error())
                     continue
 
-                self.logger.info(f"Received request code={header.code} from {header.client_id}")
+                if header.payload_size > RequestHeader.MAX_PAYLOAD_SIZE:
+                    # the rest of the stream can't be framed without reading the payload, so give up on it
+                    self.logger.error(f"Request from {self.addr} declares a {header.payload_size} byte payload; closing")
+                    self.conn.sendall(ResponseBuilder.build_error())
+                    break
+
                 try:
-                    response_bytes = self._route_request(header, payload)
-                    if response_bytes:
-                        self.conn.sendall(response_bytes)
-                except Exception as handler_err:
-                    self.logger.exception(f"Handler error: {handler_err}")
+                    payload = self._read_payload(header) # Pass header object
+
+                except Exception as parse_err:
+                    self.logger.error(f"Malformed request from {self.addr}: {parse_err}")
                     self.conn.sendall(ResponseBuilder.build_error())
+                    continue
+
+                response = self.handle(header, payload)
+                if response:
+                    ResponseWriter.send_response(self.conn, response)
         except ConnectionResetError:
             self.logger.warning(f"Connection reset by {self.addr}")
         except (socket.timeout, OSError):
@@ -54,36 +67,72 @@ class RequestHandler:
             self.conn.close()
             self.logger.info(f"Connection closed: {self.addr}")
 
-    def _recv_exact(self, size: int) -> bytes:
-        data = b""
-        while len(data) < size:
-            packet = self.conn.recv(size - len(data))
-            if not packet:
+    def handle(self, header: RequestHeader, payload: bytes):
+        """Route one parsed request and return the response (bytes or a ResponseWriter); independent of the socket model."""
+        self._sampled = self.logger.sample_request()
+        self._log_request(f"Received request code={header.code} from {header.client_id}")
+        try:
+            return self._route_request(header, payload)
+        except Exception as handler_err:
+            self.logger.exception(f"Handler error: {handler_err}")
+            return ResponseBuilder.build_error()
+
+    def _log_request(self, message: str):
+        """Per-request INFO line; skipped for requests left out by log sampling."""
+        if self._sampled:
+            self.logger.info(message)
+
+    def _recv_exact(self, size: int, buffer: bytearray = None) -> bytes:
+        """Fill a preallocated buffer with recv_into instead of concatenating bytes objects."""
+        if buffer is None or len(buffer) < size:
+            buffer = bytearray(size)
+        view = memoryview(buffer)[:size]
+        received = 0
+        while received < size:
+            count = self.conn.recv_into(view[received:], size - received)
+            if count == 0:
                 # Connection closed prematurely
                 raise ConnectionResetError("Client disconnected during read")
-            data += packet
-        return data
+            received += count
+        return bytes(view)
 
     def _read_payload(self, header: RequestHeader) -> bytes:
         payload_size = header.payload_size
         if payload_size == 0:
             return b""
-        return self._recv_exact(payload_size)
+        if payload_size <= self.BUFFER_SIZE:
+            return self._recv_exact(payload_size)
+
+        # the size is the client's claim, so memory grows with the bytes that actually arrive
+        buffer = bytearray(self.BUFFER_SIZE)
+        received = 0
+        while received < payload_size:
+            if received == len(buffer):
+                buffer.extend(bytes(min(len(buffer), payload_size - received)))
+            with memoryview(buffer) as view:
+                count = self.conn.recv_into(view[received:], len(buffer) - received)
+            if count == 0:
+                raise ConnectionResetError("Client disconnected during read")
+            received += count
+        return bytes(buffer)
 
     def _route_request(self, header: RequestHeader, payload: bytes):
         code = header.code
         client_id = header.client_id
+        compress = header.has_flag(ProtocolFlag.COMPRESSION)
 
         if code == RequestCode.REGISTER:
             return self._handle_register(payload)
         elif code == RequestCode.CLIENT_LIST:
-            return self._handle_client_list(client_id)
+            return self._handle_client_list(client_id, compress)
         elif code == RequestCode.PUBLIC_KEY:
             return self._handle_public_key(payload)
         elif code == RequestCode.SEND_MESSAGE:
             return self._handle_send_message(client_id, payload)
         elif code == RequestCode.PULL_MESSAGES:
-            return self._handle_pull_messages(client_id)
+            return self._handle_pull_messages(client_id, compress)
+        elif code == RequestCode.SEND_MULTI_MESSAGE:
+            return self._handle_send_multi_message(client_id, payload)
         else:
             self.logger.error(f"Unknown request code {code}")
             return ResponseBuilder.build_error()
@@ -124,7 +173,7 @@ class RequestHandler:
             self.logger.error(f"Public key request failed: client {target_id} not found")
             return ResponseBuilder.build_error()
 
-        self.logger.info(f"Returned public key for {client.username} ({client.id})")
+        self._log_request(f"Returned public key for {client.username} ({client.id})")
         return ResponseBuilder.build_public_key(client.id, client.public_key)
 
     def _handle_send_message(self, sender_id: uuid.UUID, payload: bytes):
@@ -139,9 +188,9 @@ class RequestHandler:
             self.logger.error(f"Send failed: destination {dest_id} not found")
             return ResponseBuilder.build_error()
 
-        # Validate message type
-        if msg_type not in [MessageType.REQUEST_SYM_KEY, MessageType.SEND_SYM_KEY,
-                            MessageType.TEXT_MESSAGE, MessageType.FILE_MESSAGE]:
+        # Validate message type (the flags are end-to-end and stored as-is)
+        if MessageFlag.base_type(msg_type) not in [MessageType.REQUEST_SYM_KEY, MessageType.SEND_SYM_KEY,
+                                                        MessageType.TEXT_MESSAGE, MessageType.FILE_MESSAGE]:
             self.logger.error(f"Unsupported message type: {msg_type}")
             return ResponseBuilder.build_error()
 
@@ -149,52 +198,74 @@ class RequestHandler:
         message = MessageRecord(dest_id, sender_id, msg_type, content)
         self.db.save_message(message)
 
-        if msg_type == MessageType.FILE_MESSAGE:
-            self.logger.info(f"Stored file message from {sender_id} to {dest_id} ({len(content)} bytes)")
+        if MessageFlag.base_type(msg_type) == MessageType.FILE_MESSAGE:
+            self._log_request(f"Stored file message from {sender_id} to {dest_id} ({len(content)} bytes)")
         else:
-            self.logger.info(f"Stored message from {sender_id} to {dest_id} (type={msg_type})")
+            self._log_request(f"Stored message from {sender_id} to {dest_id} (type={msg_type})")
 
         # Truncate UUID to 4-byte int for the protocol response
         message_id = int(message.id.int & 0xFFFFFFFF)
         return ResponseBuilder.build_message_stored(dest_id, message_id)
 
-    def _handle_pull_messages(self, client_id: uuid.UUID):
-        pending = self.db.get_pending_messages(client_id)
+    def _handle_send_multi_message(self, sender_id: uuid.UUID, payload: bytes):
+        try:
+            dest_ids, msg_type, content = PayloadParser.parse_send_multi_message_payload(payload)
+        except Exception as e:
+            self.logger.error(f"Malformed multi-recipient message payload: {e}")
+            return ResponseBuilder.build_error()
+
+        if MessageFlag.base_type(msg_type) not in [MessageType.REQUEST_SYM_KEY, MessageType.SEND_SYM_KEY,
+                                                        MessageType.TEXT_MESSAGE, MessageType.FILE_MESSAGE]:
+            self.logger.error(f"Unsupported message type: {msg_type}")
+            return ResponseBuilder.build_error()
+
+        # unknown recipients are skipped; the response lists only the mailboxes that got the message
+        known_ids = []
+        for dest_id in dict.fromkeys(dest_ids):
+            if self.db.get_client_by_id(dest_id):
+                known_ids.append(dest_id)
+            else:
+                self.logger.error(f"Multi-recipient send: destination {dest_id} not found")
+
+        if not known_ids:
+            return ResponseBuilder.build_error()
+
+        messages = self.db.save_shared_message(known_ids, sender_id, msg_type, content)
+        self._log_request(f"Stored shared message from {sender_id} for {len(messages)} recipients "
+                         f"({len(content)} bytes, type={msg_type})")
+
+        stored = [(m.to_client, int(m.id.int & 0xFFFFFFFF)) for m in messages]
+        return ResponseBuilder.build_multi_message_stored(stored)
+
+    def _handle_pull_messages(self, client_id: uuid.UUID, compress: bool = False):
+        # whatever does not fit stays in the mailbox for the next pull
+        pending = self.db.get_pending_messages(client_id, self.PULL_SIZE_LIMIT)
         if not pending:
             self.logger.debug(f"No pending messages for {client_id}")
             return ResponseBuilder.build_pending_messages(b"")
 
-        messages_bytes = b""
-        ids_to_delete = []
-        for msg in pending:
-            # MessageID is 4 bytes
-            msg_id_bytes = (int(msg.id.int & 0xFFFFFFFF)).to_bytes(4, "little")
-            
-            msg_bytes = (
-                msg.from_client.bytes +
-                msg_id_bytes +
-                msg.msg_type.to_bytes(1, "little") +
-                len(msg.content).to_bytes(4, "little") +
-                msg.content
-            )
-            messages_bytes += msg_bytes
-            ids_to_delete.append(msg.id)
-
-        # Delete messages after building the response
-        for msg_id in ids_to_delete:
-            self.db.delete_message(msg_id)
-
-        self.logger.info(f"Pulled {len(pending)} messages for {client_id}")
-        return ResponseBuilder.build_pending_messages(messages_bytes)
-
-    def _handle_client_list(self, client_id: uuid.UUID):
-        all_clients = self.db.list_clients()
-        # list should not include the requester
-        other_clients = [c for c in all_clients if c.id != client_id]
-
-        if not other_clients:
-            self.logger.info(f"Client list requested by {client_id}, no other clients found.")
+        # the response references each content; nothing is concatenated
+        response = ResponseBuilder.write_pending_messages(pending, compress)
+
+        # Delete messages after building the response; blobs it streams stay pinned until it is sent
+        try:
+            self.db.delete_messages(client_id, [msg.id for msg in pending])
+        except Exception:
+            response.close()
+            raise
+
+        self._log_request(f"Pulled {len(pending)} messages for {client_id}")
+        return response
+
+    def _handle_client_list(self, client_id: uuid.UUID, compress: bool = False):
+        # list should not include the requester; the directory leaves its record out
+        segments = self.db.client_list_segments(client_id)
+        size = sum(len(segment) for segment in segments)
+
+        if not size:
+            self._log_request(f"Client list requested by {client_id}, no other clients found.")
             return ResponseBuilder.build_client_list([])
 
-        self.logger.info(f"Returning client list ({len(other_clients)} clients) to {client_id}")
-        return ResponseBuilder.build_client_list(other_clients)
\ No newline at end of file
+        count = size // ResponseBuilder.CLIENT_LIST_RECORD_SIZE
+        self._log_request(f"Returning client list ({count} clients) to {client_id}")
+        return ResponseBuilder.write_client_list(segments, compress)
\ No newline at end of file
@@ -1,12 +1,81 @@
 from server import Server
+from async_server import AsyncServer
+from utils.logger import ServerLogger
+from storage.sweeper import ExpirySweeper
+from storage.engine import StorageEngine
+from utils.config_loader import ConfigLoader
+from protocol.enums import MessageType
+import argparse
+import sys
+
+TTL_TYPES = {
+    "request-key": MessageType.REQUEST_SYM_KEY,
+    "send-key": MessageType.SEND_SYM_KEY,
+    "text": MessageType.TEXT_MESSAGE,
+    "file": MessageType.FILE_MESSAGE,
+}
+
+def parse_ttl(value: str):
+    """TYPE=SECONDS, e.g. request-key=86400; 0 keeps that type until it is pulled."""
+    name, sep, seconds = value.partition("=")
+    if not sep or name not in TTL_TYPES or not seconds.isdigit():
+        raise argparse.ArgumentTypeError(f"expected TYPE=SECONDS with TYPE one of {', '.join(TTL_TYPES)}")
+    return TTL_TYPES[name], int(seconds)
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="MessageU server")
+    parser.add_argument("--mode", choices=["threaded", "async"], default="threaded",
+                        help="threaded: a thread per connection; async: one event loop with a worker pool")
+    parser.add_argument("--backlog", type=int, default=None, help="listen backlog")
+    parser.add_argument("--workers", type=int, default=AsyncServer.DEFAULT_WORKERS,
+                        help="handler threads in async mode")
+    parser.add_argument("--shards", type=int, default=1,
+                        help="message shards: mailboxes are spread over N database files, each with its own writer")
+    parser.add_argument("--ttl", type=parse_ttl, action="append", default=[], metavar="TYPE=SECONDS",
+                        help="how long an undelivered message of TYPE is kept (repeatable); "
+                             "by default every type is kept until pulled")
+    parser.add_argument("--sweep-interval", type=float, default=ExpirySweeper.DEFAULT_INTERVAL,
+                        help="seconds between expiry sweeps; 0 disables the sweeper")
+    parser.add_argument("--vacuum", action="store_true",
+                        help="convert existing databases to incremental vacuum with a one-time full VACUUM, then exit")
+    parser.add_argument("--log-mode", choices=["async", "sync"], default="async",
+                        help="async: handlers only enqueue records; a writer thread formats and flushes them in batches")
+    parser.add_argument("--log-level", choices=["DEBUG", "INFO", "WARNING", "ERROR"], default="DEBUG")
+    parser.add_argument("--log-sample", type=int, default=1,
+                        help="log the per-request lines of 1 in N requests")
+    return parser.parse_args()
+
+def vacuum(shards: int):
+    """Run the blocking conversion while no server is using the files."""
+    config = ConfigLoader()
+    ServerLogger(config.log_path)
+    try:
+        engine = StorageEngine.instance(config.db_path, shards)
+    except ValueError as e:
+        sys.exit(f"Error: {e}")
+    engine.convert_to_incremental_vacuum()
+    engine.close()
 
 def main():
     """
     Main entry point for the server.
     Initializes and runs the server.
     """
-    server = Server()
+    args = parse_args()
+    ServerLogger.configure(args.log_mode == "async", args.log_level, args.log_sample)
+    storage = dict(shards=args.shards, message_ttl=dict(args.ttl), sweep_interval=args.sweep_interval)
+    if args.vacuum:
+        vacuum(args.shards)
+        return
+    try:
+        if args.mode == "async":
+            server = AsyncServer(args.backlog or AsyncServer.DEFAULT_BACKLOG, args.workers, **storage)
+        else:
+            server = Server(args.backlog or Server.DEFAULT_BACKLOG, **storage)
+    except ValueError as e:
+        # e.g. a shard count that does not match the existing database
+        sys.exit(f"Error: {e}")
     server.run()
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
@@ -1,9 +1,31 @@
 ﻿import struct
 import uuid
+import zlib
 from .header import ResponseHeader
-from .enums import ResponseCode, ProtocolVersion
+from .enums import ResponseCode, ProtocolVersion, ProtocolFlag
+from .response_writer import ResponseWriter, FileSegment
+
+PENDING_MESSAGE_HEADER_FORMAT = "<16sIBI"  # From(16) + MessageID(4) + Type(1) + ContentSize(4)
+PENDING_MESSAGE_HEADER_SIZE = struct.calcsize(PENDING_MESSAGE_HEADER_FORMAT)
 
 class ResponseBuilder:
+    COMPRESSION_LEVEL = ResponseWriter.COMPRESSION_LEVEL
+    MIN_COMPRESS_SIZE = ResponseWriter.MIN_COMPRESS_SIZE
+    CLIENT_NAME_SIZE = 255
+    CLIENT_LIST_RECORD_SIZE = 16 + CLIENT_NAME_SIZE
+
+    @staticmethod
+    def _build(code: int, payload: bytes, compress: bool = False) -> bytes:
+        """Compress the payload when the client asked for it and it actually shrinks."""
+        version = ProtocolVersion.SERVER
+        if compress and len(payload) >= ResponseBuilder.MIN_COMPRESS_SIZE:
+            packed = zlib.compress(payload, ResponseBuilder.COMPRESSION_LEVEL)
+            if len(packed) < len(payload):
+                payload = packed
+                version |= ProtocolFlag.COMPRESSION
+        header = ResponseHeader(version, code, len(payload))
+        return header.to_bytes() + payload
+
     @staticmethod
     def make_header(code: int, payload_size: int) -> bytes:
         header = ResponseHeader(ProtocolVersion.SERVER, code, payload_size)
@@ -16,12 +38,23 @@ class ResponseBuilder:
         return header.to_bytes() + payload
 
     @staticmethod
-    def build_client_list(client_records) -> bytes:
+    def client_list_record(client_id: uuid.UUID, username: str) -> bytes:
+        return client_id.bytes + username.encode('ascii').ljust(ResponseBuilder.CLIENT_NAME_SIZE, b'\x00')
+
+    @staticmethod
+    def build_client_list(client_records, compress: bool = False) -> bytes:
         payload = b"".join([
-            c.id.bytes + c.username.encode('ascii').ljust(255, b'\x00') for c in client_records
+            ResponseBuilder.client_list_record(c.id, c.username) for c in client_records
         ])
-        header = ResponseHeader(ProtocolVersion.SERVER, ResponseCode.CLIENT_LIST, len(payload))
-        return header.to_bytes() + payload
+        return ResponseBuilder._build(ResponseCode.CLIENT_LIST, payload, compress)
+
+    @staticmethod
+    def write_client_list(segments, compress: bool = False) -> ResponseWriter:
+        """CLIENT_LIST response around records that are already serialized."""
+        writer = ResponseWriter(ResponseCode.CLIENT_LIST, compress)
+        for segment in segments:
+            writer.append(segment)
+        return writer
 
     @staticmethod
     def build_public_key(client_id: uuid.UUID, public_key: bytes) -> bytes:
@@ -40,10 +73,31 @@ class ResponseBuilder:
         return header.to_bytes() + payload
 
     @staticmethod
-    def build_pending_messages(payload: bytes) -> bytes:
-        header = ResponseHeader(ProtocolVersion.SERVER, ResponseCode.PENDING_MESSAGES, len(payload))
+    def build_multi_message_stored(stored) -> bytes:
+        payload = b"".join([
+            to_client.bytes + struct.pack("<I", message_id) for to_client, message_id in stored
+        ])
+        header = ResponseHeader(ProtocolVersion.SERVER, ResponseCode.MULTI_MESSAGE_STORED, len(payload))
         return header.to_bytes() + payload
 
+    @staticmethod
+    def build_pending_messages(payload: bytes, compress: bool = False) -> bytes:
+        return ResponseBuilder._build(ResponseCode.PENDING_MESSAGES, payload, compress)
+
+    @staticmethod
+    def write_pending_messages(messages, compress: bool = False) -> ResponseWriter:
+        """PENDING_MESSAGES response that references each stored content instead of copying it."""
+        writer = ResponseWriter(ResponseCode.PENDING_MESSAGES, compress)
+        for msg in messages:
+            # MessageID is the low 4 bytes of the stored UUID
+            writer.append(struct.pack(PENDING_MESSAGE_HEADER_FORMAT, msg.from_client.bytes,
+                                      int(msg.id.int & 0xFFFFFFFF), msg.msg_type, len(msg.content)))
+            if isinstance(msg.content, FileSegment):
+                writer.append_file(msg.content)
+            else:
+                writer.append(msg.content)
+        return writer
+
     @staticmethod
     def build_error() -> bytes:
         header = ResponseHeader(ProtocolVersion.SERVER, ResponseCode.GENERAL_ERROR, 0)
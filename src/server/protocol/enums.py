@@ -6,6 +6,7 @@ class RequestCode(IntEnum):
     PUBLIC_KEY = 602
     SEND_MESSAGE = 603
     PULL_MESSAGES = 604
+    SEND_MULTI_MESSAGE = 605
 
 
 class ResponseCode(IntEnum):
@@ -14,6 +15,7 @@ class ResponseCode(IntEnum):
     PUBLIC_KEY = 2102
     MESSAGE_STORED = 2103
     PENDING_MESSAGES = 2104
+    MULTI_MESSAGE_STORED = 2105
     GENERAL_ERROR = 9000
 
 
@@ -27,3 +29,20 @@ class MessageType(IntEnum):
 class ProtocolVersion(IntEnum):
     SERVER = 2
     CLIENT = 1
+
+
+class ProtocolFlag(IntEnum):
+    # high bit of the header version byte: the sender accepts / sends zlib-compressed payloads
+    COMPRESSION = 0x80
+
+
+class MessageFlag(IntEnum):
+    # high bit of the message type byte: the plaintext was zlib-compressed before encryption
+    COMPRESSED = 0x80
+    # next bit: the content starts with a one-time key wrapped for each recipient (group send)
+    GROUP_KEYS = 0x40
+
+    @classmethod
+    def base_type(cls, msg_type: int) -> int:
+        """The message type with the end-to-end flags removed."""
+        return msg_type & ~(cls.COMPRESSED | cls.GROUP_KEYS)
@@ -7,6 +7,7 @@ RESPONSE_HEADER_FORMAT = "<BHI"    # Version(1) + Code(2) + PayloadSize(4)
 
 class RequestHeader:
     SIZE = struct.calcsize(REQUEST_HEADER_FORMAT)
+    MAX_PAYLOAD_SIZE = 64 * 1024 * 1024  # larger requests are refused before any allocation
 
     def __init__(self, client_id: uuid.UUID, version: int, code: int, payload_size: int):
         self.client_id = client_id
@@ -14,6 +15,13 @@ class RequestHeader:
         self.code = code
         self.payload_size = payload_size
 
+    @property
+    def protocol_version(self) -> int:
+        return self.version & 0x7F
+
+    def has_flag(self, flag: int) -> bool:
+        return bool(self.version & flag)
+
     @classmethod
     def from_bytes(cls, data: bytes):
         client_id, version, code, payload_size = struct.unpack(REQUEST_HEADER_FORMAT, data)
@@ -17,6 +17,8 @@ class RequestParser:
             return PayloadParser.parse_register_payload(payload)
         elif code == RequestCode.SEND_MESSAGE:
             return PayloadParser.parse_send_message_payload(payload)
+        elif code == RequestCode.SEND_MULTI_MESSAGE:
+            return PayloadParser.parse_send_multi_message_payload(payload)
         elif code == RequestCode.PULL_MESSAGES:
             return PayloadParser.parse_pull_payload(payload)
         elif code == RequestCode.CLIENT_LIST:
@@ -35,6 +35,23 @@ class PayloadParser:
         content = data[21:21 + size]
         return dest_id, msg_type, content
 
+    @staticmethod
+    def parse_send_multi_message_payload(data: bytes):
+        count = struct.unpack("<H", data[:2])[0]
+        if count == 0:
+            raise ValueError("Multi-recipient message has no recipients")
+        offset = 2
+        dest_ids = []
+        for _ in range(count):
+            dest_ids.append(uuid.UUID(bytes=data[offset:offset + 16]))
+            offset += 16
+        msg_type = data[offset]
+        size = struct.unpack("<I", data[offset + 1:offset + 5])[0]
+        content = data[offset + 5:offset + 5 + size]
+        if len(content) != size:
+            raise ValueError(f"Truncated multi-recipient content: expected {size} bytes, got {len(content)}")
+        return dest_ids, msg_type, content
+
     @staticmethod
     def parse_pull_payload(data: bytes):
         return uuid.UUID(bytes=data[:16])
@@ -0,0 +1,151 @@
+import socket
+import zlib
+from typing import Callable, List, Optional, Union
+from .header import ResponseHeader
+from .enums import ProtocolVersion, ProtocolFlag
+
+Buffer = Union[bytes, bytearray, memoryview]
+
+
+class FileSegment:
+    """Payload bytes that stay in a file until they are sent.
+
+    The file is opened on first use, so a response holding many of them does not hold as many
+    descriptors. on_close runs once, when the response is done with the file.
+    """
+
+    def __init__(self, path: str, size: int, on_close: Optional[Callable[[], None]] = None):
+        self.path = path
+        self.size = size
+        self._on_close = on_close
+        self._file = None
+
+    def __len__(self) -> int:
+        return self.size
+
+    def open(self):
+        if self._file is None:
+            self._file = open(self.path, "rb")
+        return self._file
+
+    def close(self) -> None:
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+        if self._on_close:
+            on_close, self._on_close = self._on_close, None
+            on_close()
+
+
+class ResponseWriter:
+    """A response kept as separate buffers: the header followed by payload segments.
+
+    Segments are appended as memoryviews and are never concatenated; send() hands them to
+    the kernel with one scatter/gather sendmsg per IOV_MAX segments. Compression streams the
+    segments through one compressor, so it does not need a joined copy either.
+
+    File segments are sent with sendfile and never read into memory. A response holding any is
+    not compressed: the files hold encrypted content, which does not shrink. close() releases
+    them and must be called once the response is sent or dropped.
+    """
+
+    IOV_MAX = 1024
+    COMPRESSION_LEVEL = 6
+    MIN_COMPRESS_SIZE = 256
+
+    def __init__(self, code: int, compress: bool = False):
+        self.code = code
+        self.compress = compress
+        self._segments: List[Union[memoryview, FileSegment]] = []
+        self._payload_size = 0
+        self._has_files = False
+
+    def append(self, segment: Buffer) -> None:
+        if segment:
+            view = memoryview(segment).cast("B")
+            self._segments.append(view)
+            self._payload_size += len(view)
+
+    def append_file(self, segment: FileSegment) -> None:
+        self._segments.append(segment)
+        self._payload_size += segment.size
+        self._has_files = True
+
+    @property
+    def payload_size(self) -> int:
+        return self._payload_size
+
+    def parts(self) -> List[Union[memoryview, FileSegment]]:
+        """Header plus payload segments; file segments are left for sendfile."""
+        version = ProtocolVersion.SERVER
+        segments = self._segments
+        size = self._payload_size
+
+        if self.compress and size >= self.MIN_COMPRESS_SIZE and not self._has_files:
+            compressor = zlib.compressobj(self.COMPRESSION_LEVEL)
+            packed = [compressor.compress(segment) for segment in segments]
+            packed.append(compressor.flush())
+            packed_size = sum(len(chunk) for chunk in packed)
+            if packed_size < size:
+                segments = [memoryview(chunk) for chunk in packed if chunk]
+                size = packed_size
+                version |= ProtocolFlag.COMPRESSION
+
+        header = ResponseHeader(version, self.code, size).to_bytes()
+        return [memoryview(header)] + segments
+
+    def runs(self):
+        """parts() grouped for sending: lists of consecutive buffers, and single file segments."""
+        run = []
+        for part in self.parts():
+            if isinstance(part, FileSegment):
+                if run:
+                    yield run
+                    run = []
+                yield part
+            else:
+                run.append(part)
+        if run:
+            yield run
+
+    def close(self) -> None:
+        for segment in self._segments:
+            if isinstance(segment, FileSegment):
+                segment.close()
+
+    def send(self, sock: socket.socket) -> None:
+        """Write the whole response and release its files."""
+        try:
+            for run in self.runs():
+                if isinstance(run, FileSegment):
+                    # socket.sendfile uses os.sendfile where available and plain sends elsewhere
+                    sock.sendfile(run.open(), 0, run.size)
+                else:
+                    self._send_buffers(sock, run)
+        finally:
+            self.close()
+
+    def _send_buffers(self, sock: socket.socket, buffers: List[memoryview]) -> None:
+        """One sendmsg per IOV_MAX buffers; one sendall per buffer without sendmsg."""
+        if not hasattr(sock, "sendmsg"):
+            for buffer in buffers:
+                sock.sendall(buffer)
+            return
+
+        buffers = list(buffers)
+        index = 0
+        while index < len(buffers):
+            sent = sock.sendmsg(buffers[index:index + self.IOV_MAX])
+            # skip what went out, keeping the unsent tail of a partly sent segment
+            while index < len(buffers) and sent >= len(buffers[index]):
+                sent -= len(buffers[index])
+                index += 1
+            if sent:
+                buffers[index] = buffers[index][sent:]
+
+    @staticmethod
+    def send_response(sock: socket.socket, response: Union[bytes, "ResponseWriter"]) -> None:
+        if isinstance(response, ResponseWriter):
+            response.send(sock)
+        else:
+            sock.sendall(response)
@@ -1,20 +1,29 @@
 from utils.config_loader import ConfigLoader
 from utils.logger import ServerLogger
 from handler import RequestHandler
+from storage.engine import StorageEngine
+from storage.sweeper import ExpirySweeper
 import socket
 import threading
 
 
 class Server:
-    def __init__(self):
+    DEFAULT_BACKLOG = 128
+
+    def __init__(self, backlog: int = DEFAULT_BACKLOG, shards: int = 1, message_ttl=None,
+                 sweep_interval: float = ExpirySweeper.DEFAULT_INTERVAL):
         self.config = ConfigLoader()
         self.logger = ServerLogger(self.config.log_path)
         self.host = "0.0.0.0"
         self.port = self.config.port
+        # opened once here so schema setup happens before the first connection
+        self.storage = StorageEngine.instance(self.config.db_path, shards, message_ttl)
+        self.sweeper = ExpirySweeper(self.storage, sweep_interval) if sweep_interval > 0 else None
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.socket.bind((self.host, self.port))
-        self.socket.listen(5)
-        self.logger.info(f"Server (v{self.config.version}) started on port {self.port}")
+        self.socket.listen(backlog)
+        self.logger.info(f"Server (v{self.config.version}) started on port {self.port} "
+                         f"({len(self.storage.shards)} message shard(s))")
 
     def handle_client(self, conn, addr):
         self.logger.info(f"New connection from {addr}")
@@ -25,6 +34,8 @@ class Server:
         self.logger.separator()
         self.logger.info("Server is running and waiting for connections.")
         self.socket.settimeout(1.0)  # 1 second timeout
+        if self.sweeper:
+            self.sweeper.start()
         try:
             while True:
                 try:
@@ -36,4 +47,7 @@ class Server:
         except KeyboardInterrupt:
             self.logger.info("KeyboardInterrupt received. Shutting down server gracefully...")
             self.socket.close()
+            if self.sweeper:
+                self.sweeper.close()
+            self.storage.close()
             exit(0)
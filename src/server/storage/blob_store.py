@@ -0,0 +1,134 @@
+import hashlib
+import os
+import shutil
+import threading
+import uuid
+from typing import Dict, Optional, Set
+from protocol.response_writer import FileSegment
+
+
+class BlobStore:
+    """Content-addressed files for message content too large to keep in SQLite.
+
+    A blob lives at <root>/<first two hex digits>/<sha256>; the database only keeps its hash,
+    size and reference count. Files are written to a temporary name and renamed into place,
+    so a reader never sees a partial blob and concurrent writers of the same content agree.
+
+    A pull references blobs that its own deletes may release before the response is sent, so
+    the pull pins them: a blob released while pinned is unlinked when the last pin goes away.
+
+    Releases are applied after the deleting transaction commits. Every ensure() bumps the blob's
+    generation, so a release that raced with a new reference to the same content is dropped.
+    """
+
+    MIN_SIZE = 64 * 1024  # content below this stays in the database
+
+    def __init__(self, root: str, min_size: int = MIN_SIZE):
+        self.root = root
+        self.min_size = min_size
+        os.makedirs(self.root, exist_ok=True)
+        self._lock = threading.Lock()
+        self._pins: Dict[str, int] = {}
+        self._released: Set[str] = set()
+        self._generations: Dict[str, int] = {}
+
+    def accepts(self, size: int) -> bool:
+        return size >= self.min_size
+
+    def path(self, blob_hash: str) -> str:
+        return os.path.join(self.root, blob_hash[:2], blob_hash)
+
+    @staticmethod
+    def hash(content: bytes) -> str:
+        return hashlib.sha256(content).hexdigest()
+
+    def put(self, content: bytes) -> str:
+        """Write content unless it is already stored; returns its hash."""
+        blob_hash = self.hash(content)
+        self.ensure(blob_hash, content)
+        return blob_hash
+
+    def ensure(self, blob_hash: str, content: bytes) -> None:
+        """Make sure the file for blob_hash exists and is not scheduled for removal."""
+        path = self.path(blob_hash)
+        with self._lock:
+            self._released.discard(blob_hash)
+            self._generations[blob_hash] = self._generations.get(blob_hash, 0) + 1
+            if os.path.exists(path):
+                return
+        directory = os.path.dirname(path)
+        if not os.path.isdir(directory):
+            os.makedirs(directory, exist_ok=True)
+            self._sync_directory(self.root)
+        temp_path = f"{path}.{uuid.uuid4().hex}.tmp"
+        with open(temp_path, "wb") as file:
+            file.write(content)
+            file.flush()
+            os.fsync(file.fileno())
+        os.replace(temp_path, path)
+        # the reference is committed next, so the rename must reach the disk first
+        self._sync_directory(directory)
+
+    def open(self, blob_hash: str, size: int) -> Optional[FileSegment]:
+        """Pin the blob and return a segment that streams it; closing the segment unpins it.
+
+        None when the file is already gone: the release of its last reference committed after
+        the caller read the row, so the message it read was pulled or expired in the meantime.
+        """
+        with self._lock:
+            # checked under the lock that removal takes, so once pinned the file stays
+            if not os.path.exists(self.path(blob_hash)):
+                return None
+            self._pins[blob_hash] = self._pins.get(blob_hash, 0) + 1
+        return FileSegment(self.path(blob_hash), size, lambda: self._unpin(blob_hash))
+
+    def generation(self, blob_hash: str) -> int:
+        with self._lock:
+            return self._generations.get(blob_hash, 0)
+
+    def remove(self, blob_hash: str, generation: int) -> None:
+        """Called once the release of the last reference committed; a pinned blob is removed when unpinned."""
+        with self._lock:
+            if self._generations.get(blob_hash, 0) != generation:
+                return
+            if self._pins.get(blob_hash):
+                self._released.add(blob_hash)
+            else:
+                self._unlink(blob_hash)
+
+    def clear(self) -> None:
+        with self._lock:
+            self._released.clear()
+            self._generations.clear()
+        shutil.rmtree(self.root, ignore_errors=True)
+        os.makedirs(self.root, exist_ok=True)
+
+    def _unpin(self, blob_hash: str) -> None:
+        with self._lock:
+            count = self._pins[blob_hash] - 1
+            if count:
+                self._pins[blob_hash] = count
+                return
+            del self._pins[blob_hash]
+            if blob_hash in self._released:
+                self._released.discard(blob_hash)
+                self._unlink(blob_hash)
+
+    @staticmethod
+    def _sync_directory(directory: str) -> None:
+        # Windows has no directory fsync; the NTFS journal is all there is for the rename
+        if not hasattr(os, "O_DIRECTORY"):
+            return
+        fd = os.open(directory, os.O_RDONLY | os.O_DIRECTORY)
+        try:
+            os.fsync(fd)
+        finally:
+            os.close(fd)
+
+    def _unlink(self, blob_hash: str) -> None:
+        # callers hold _lock, so ensure() cannot see the file just before it goes away
+        self._generations.pop(blob_hash, None)
+        try:
+            os.remove(self.path(blob_hash))
+        except OSError:
+            pass
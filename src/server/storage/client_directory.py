@@ -0,0 +1,96 @@
+import sqlite3
+import threading
+import uuid
+from datetime import datetime
+from typing import Dict, List, Optional
+from models.client import ClientRecord
+from protocol.builder import ResponseBuilder
+
+
+SQL_LOAD_CLIENTS = "SELECT id, username, public_key, last_seen FROM clients"
+SQL_INSERT_CLIENT = "INSERT INTO clients (id, username, public_key, last_seen) VALUES (?, ?, ?, ?)"
+
+
+class ClientDirectory:
+    """Write-through, in-memory copy of the clients table.
+
+    Loaded once when the engine starts; lookups by id or username and CLIENT_LIST requests are
+    answered from memory. The CLIENT_LIST payload is kept serialized and grows by one record
+    per registration. Requests share an immutable snapshot of it, taken once per change, and
+    get the two views around their own record, so a list request copies nothing.
+    """
+
+    def __init__(self, engine):
+        self._engine = engine
+        self._lock = threading.Lock()
+        self._by_id: Dict[uuid.UUID, ClientRecord] = {}
+        self._by_username: Dict[str, ClientRecord] = {}
+        self._list_payload = bytearray()
+        self._list_snapshot = b""
+        self._list_offsets: Dict[uuid.UUID, int] = {}
+        self._load()
+
+    def _load(self) -> None:
+        with self._engine.reader() as conn:
+            rows = conn.execute(SQL_LOAD_CLIENTS).fetchall()
+        for row in rows:
+            client = ClientRecord(row[1].decode("ascii"), row[2], uuid.UUID(row[0]))
+            client._last_seen = datetime.fromisoformat(row[3])
+            self._insert_locked(client)
+
+    def _insert_locked(self, client: ClientRecord) -> None:
+        self._by_id[client.id] = client
+        self._by_username[client.username] = client
+        self._list_offsets[client.id] = len(self._list_payload)
+        self._list_payload += ResponseBuilder.client_list_record(client.id, client.username)
+        self._list_snapshot = None
+
+    def add(self, client: ClientRecord) -> None:
+        """Persist a new client, then publish it; raises ValueError for a taken username."""
+        with self._lock:
+            if client.username in self._by_username:
+                raise ValueError(f"Client with username '{client.username}' already exists")
+            try:
+                with self._engine.writer() as conn:
+                    conn.execute(
+                        SQL_INSERT_CLIENT,
+                        (
+                            str(client.id),
+                            client.username_raw,  # store as raw BLOB including null
+                            client.public_key,
+                            client.last_seen.isoformat(),
+                        ),
+                    )
+            except sqlite3.IntegrityError as e:
+                raise ValueError(f"Client with username '{client.username}' already exists") from e
+            self._insert_locked(client)
+
+    def clear(self) -> None:
+        """Forget every client; the caller has already emptied the table."""
+        with self._lock:
+            self._by_id.clear()
+            self._by_username.clear()
+            self._list_payload = bytearray()
+            self._list_snapshot = b""
+            self._list_offsets.clear()
+
+    def get_by_id(self, client_id: uuid.UUID) -> Optional[ClientRecord]:
+        return self._by_id.get(client_id)
+
+    def get_by_username(self, username: str) -> Optional[ClientRecord]:
+        return self._by_username.get(username)
+
+    def list_clients(self) -> List[ClientRecord]:
+        with self._lock:
+            return list(self._by_id.values())
+
+    def client_list_segments(self, exclude_id: uuid.UUID) -> List[memoryview]:
+        """Views of the serialized CLIENT_LIST records of every client except exclude_id."""
+        with self._lock:
+            if self._list_snapshot is None:
+                self._list_snapshot = bytes(self._list_payload)
+            snapshot = memoryview(self._list_snapshot)
+            offset = self._list_offsets.get(exclude_id)
+        if offset is None:
+            return [snapshot]
+        return [snapshot[:offset], snapshot[offset + ResponseBuilder.CLIENT_LIST_RECORD_SIZE:]]
@@ -2,152 +2,224 @@ import sqlite3
 from typing import List, Optional
 from models.client import ClientRecord
 from models.message import MessageRecord
-from datetime import datetime
+from storage.engine import StorageEngine
+from protocol.builder import PENDING_MESSAGE_HEADER_SIZE
 import uuid
-import os
-import threading
+import hashlib
 
 
+# statement text is kept constant so each connection's statement cache reuses the prepared form
+SQL_INSERT_MESSAGE = "INSERT INTO messages (id, to_client, from_client, msg_type, content, expires_at) VALUES (?, ?, ?, ?, ?, ?)"
+SQL_INSERT_SHARED_MESSAGE = "INSERT INTO messages (id, to_client, from_client, msg_type, content, blob_hash, expires_at) VALUES (?, ?, ?, ?, NULL, ?, ?)"
+SQL_ADD_BLOB_REFS = "UPDATE message_blobs SET ref_count = ref_count + ? WHERE hash = ?"
+SQL_INSERT_BLOB = "INSERT INTO message_blobs (hash, content, ref_count, size) VALUES (?, ?, ?, ?)"
+SQL_PENDING_MESSAGES = """
+    SELECT m.id, m.to_client, m.from_client, m.msg_type, COALESCE(m.content, b.content), m.blob_hash, b.size
+    FROM messages m LEFT JOIN message_blobs b ON m.blob_hash = b.hash
+    WHERE m.to_client = ?
+    ORDER BY m.rowid
+"""
+SQL_MESSAGE_BLOB_HASH = "SELECT blob_hash FROM messages WHERE id = ?"
+SQL_DELETE_MESSAGE = "DELETE FROM messages WHERE id = ?"
+SQL_BLOB_REFS = "SELECT ref_count, content IS NULL FROM message_blobs WHERE hash = ?"
+SQL_RELEASE_BLOB = "UPDATE message_blobs SET ref_count = ref_count - 1 WHERE hash = ?"
+SQL_DELETE_BLOB = "DELETE FROM message_blobs WHERE hash = ?"
+SQL_EXPIRED_MESSAGES = "SELECT id, blob_hash FROM messages WHERE expires_at IS NOT NULL AND expires_at <= ? LIMIT ?"
+
 class DatabaseManager:
-    """Thread-safe SQLite database manager with BLOB username + key storage."""
+    """Client and message storage on top of the process-wide StorageEngine.
+
+    Creating a manager is cheap: the connections, schema setup and locking live in the
+    engine shared by every manager for the same database file.
+    """
 
     def __init__(self, db_path: str = "defensive.db"):
         self.db_path = db_path
-        self._lock = threading.Lock()
-        self.conn = sqlite3.connect(self.db_path, check_same_thread=False)
-        self.conn.execute("PRAGMA foreign_keys = ON;")
-        self._ensure_database()
-
-    # ---------- Initialization ----------
-    def _ensure_database(self) -> None:
-        """Create database tables if they do not exist."""
-        if os.path.dirname(self.db_path):
-            os.makedirs(os.path.dirname(self.db_path), exist_ok=True)
-        with self._lock:
-            self.conn.execute("""
-                CREATE TABLE IF NOT EXISTS clients (
-                    id TEXT PRIMARY KEY,
-                    username BLOB UNIQUE,
-                    public_key BLOB,
-                    last_seen TEXT
-                )
-            """)
-            self.conn.execute("""
-                CREATE TABLE IF NOT EXISTS messages (
-                    id TEXT PRIMARY KEY,
-                    to_client TEXT,
-                    from_client TEXT,
-                    msg_type INTEGER,
-                    content BLOB
-                )
-            """)
-            self.conn.commit()
+        self.engine = StorageEngine.instance(db_path)
 
+    # ---------- Client Directory (served from memory) ----------
     def add_client(self, client: ClientRecord) -> None:
-        with self._lock:
-            try:
-                self.conn.execute(
-                    "INSERT INTO clients (id, username, public_key, last_seen) VALUES (?, ?, ?, ?)",
-                    (
-                        str(client.id),
-                        client.username_raw,  # store as raw BLOB including null
-                        client.public_key,
-                        client.last_seen.isoformat(),
-                    ),
-                )
-                self.conn.commit()
-            except sqlite3.IntegrityError as e:
-                raise ValueError(f"Client with username '{client.username}' already exists") from e
+        self.engine.directory.add(client)
 
     def get_client_by_username(self, username: str) -> Optional[ClientRecord]:
-        # include null termination when searching
-        name_bytes = username.encode("ascii") + b"\x00"
-        with self._lock:
-            row = self.conn.execute(
-                "SELECT id, username, public_key, last_seen FROM clients WHERE username = ?",
-                (name_bytes,),
-            ).fetchone()
-            if not row:
-                return None
-            username_clean = row[1].decode("ascii")
-            c = ClientRecord(username_clean, row[2], uuid.UUID(row[0]))
-            c._last_seen = datetime.fromisoformat(row[3])
-            return c
+        return self.engine.directory.get_by_username(username)
 
     def get_client_by_id(self, client_id: uuid.UUID) -> Optional[ClientRecord]:
-        with self._lock:
-            row = self.conn.execute(
-                "SELECT id, username, public_key, last_seen FROM clients WHERE id = ?",
-                (str(client_id),),
-            ).fetchone()
-            if not row:
-                return None
-            username_clean = row[1].decode("ascii")
-            c = ClientRecord(username_clean, row[2], uuid.UUID(row[0]))
-            c._last_seen = datetime.fromisoformat(row[3])
-            return c
+        return self.engine.directory.get_by_id(client_id)
 
     def list_clients(self) -> List[ClientRecord]:
-        with self._lock:
-            rows = self.conn.execute("SELECT id, username, public_key, last_seen FROM clients").fetchall()
-            clients = []
-            for row in rows:
-                username_clean = row[1].decode("ascii")
-                c = ClientRecord(username_clean, row[2], uuid.UUID(row[0]))
-                c._last_seen = datetime.fromisoformat(row[3])
-                clients.append(c)
-            return clients
+        return self.engine.directory.list_clients()
+
+    def client_list_segments(self, exclude_id: uuid.UUID) -> List[memoryview]:
+        return self.engine.directory.client_list_segments(exclude_id)
 
     # ---------- Message Management ----------
+    # every mailbox operation runs on the shard of the recipient
     def save_message(self, message: MessageRecord) -> None:
-        with self._lock:
-            self.conn.execute(
-                "INSERT INTO messages (id, to_client, from_client, msg_type, content) VALUES (?, ?, ?, ?, ?)",
-                (
-                    str(message.id),
-                    str(message.to_client),
-                    str(message.from_client),
-                    message.msg_type,
-                    message.content,
-                ),
+        """Returns once the transaction holding the insert is committed."""
+        shard = self.engine.shard_for(message.to_client)
+        content = message.content
+        expires_at = self.engine.expires_at(message.msg_type)
+        if not shard.blobs.accepts(len(content)):
+            row = (
+                str(message.id),
+                str(message.to_client),
+                str(message.from_client),
+                message.msg_type,
+                content,
+                expires_at,
             )
-            self.conn.commit()
-
-    def get_pending_messages(self, client_id: uuid.UUID) -> List[MessageRecord]:
-        with self._lock:
-            rows = self.conn.execute(
-                "SELECT id, to_client, from_client, msg_type, content FROM messages WHERE to_client = ?",
-                (str(client_id),),
-            ).fetchall()
-            messages = []
-            for row in rows:
-                messages.append(
-                    MessageRecord(
-                        uuid.UUID(row[1]),
-                        uuid.UUID(row[2]),
-                        int(row[3]),
-                        row[4],
-                        uuid.UUID(row[0]),
-                    )
+            shard.group_commit.submit(lambda conn: conn.execute(SQL_INSERT_MESSAGE, row))
+            return
+
+        # large content goes to the blob store first; the transaction only records the reference
+        blob_hash = shard.blobs.put(content)
+        row = (str(message.id), str(message.to_client), str(message.from_client), message.msg_type, blob_hash, expires_at)
+
+        def insert(conn: sqlite3.Connection) -> None:
+            self._add_blob_refs(shard, conn, blob_hash, content, 1)
+            conn.execute(SQL_INSERT_SHARED_MESSAGE, row)
+
+        shard.group_commit.submit(insert)
+
+    def save_shared_message(self, to_clients: List[uuid.UUID], from_client: uuid.UUID,
+                            msg_type: int, content: bytes) -> List[MessageRecord]:
+        """Store one copy of content per shard, referenced by a mailbox row per recipient."""
+        blob_hash = hashlib.sha256(content).hexdigest()
+        expires_at = self.engine.expires_at(msg_type)
+        messages = [MessageRecord(to_client, from_client, msg_type, content) for to_client in to_clients]
+        by_shard = {}
+        for m in messages:
+            by_shard.setdefault(self.engine.shard_for(m.to_client), []).append(m)
+
+        for shard, shard_messages in by_shard.items():
+            if shard.blobs.accepts(len(content)):
+                shard.blobs.ensure(blob_hash, content)
+            with shard.writer() as conn:
+                self._add_blob_refs(shard, conn, blob_hash, content, len(shard_messages))
+                conn.executemany(
+                    SQL_INSERT_SHARED_MESSAGE,
+                    [
+                        (str(m.id), str(m.to_client), str(m.from_client), m.msg_type, blob_hash, expires_at)
+                        for m in shard_messages
+                    ],
+                )
+        return messages
+
+    def get_pending_messages(self, client_id: uuid.UUID, max_bytes: int = None) -> List[MessageRecord]:
+        """Oldest first, up to max_bytes of content and record headers; the first message is always
+        included. Content kept in the blob store comes back as a FileSegment; the caller must close it."""
+        shard = self.engine.shard_for(client_id)
+        rows = []
+        total = 0
+        with shard.reader() as conn:
+            # rows are fetched as they are walked, so the content of messages left for the next pull is never read
+            for row in conn.execute(SQL_PENDING_MESSAGES, (str(client_id),)):
+                size = len(row[4]) if row[4] is not None else (row[6] or 0)
+                total += PENDING_MESSAGE_HEADER_SIZE + size
+                if rows and max_bytes is not None and total > max_bytes:
+                    break
+                rows.append(row)
+        messages = []
+        for row in rows:
+            content = row[4]
+            if content is None and row[5]:
+                content = shard.blobs.open(row[5], row[6])
+                if content is None:
+                    # a concurrent pull or the sweeper took this message after the rows were read
+                    continue
+            messages.append(
+                MessageRecord(
+                    uuid.UUID(row[1]),
+                    uuid.UUID(row[2]),
+                    int(row[3]),
+                    content,
+                    uuid.UUID(row[0]),
                 )
-            return messages
+            )
+        return messages
+
+    def delete_message(self, client_id: uuid.UUID, message_id: uuid.UUID) -> None:
+        self.delete_messages(client_id, [message_id])
+
+    def delete_messages(self, client_id: uuid.UUID, message_ids: List[uuid.UUID]) -> None:
+        """Delete a pulled batch from client_id's mailbox in one grouped write."""
+        shard = self.engine.shard_for(client_id)
+        released = []
+
+        def delete(conn: sqlite3.Connection) -> None:
+            for message_id in message_ids:
+                row = conn.execute(SQL_MESSAGE_BLOB_HASH, (str(message_id),)).fetchone()
+                conn.execute(SQL_DELETE_MESSAGE, (str(message_id),))
+                if row and row[0]:
+                    self._release_blob(shard, conn, row[0], released)
+
+        if message_ids:
+            shard.group_commit.submit(delete)
+            self._remove_blobs(shard, released)
+
+    def delete_expired(self, shard: StorageEngine, now: int, limit: int) -> int:
+        """Delete up to limit messages of one shard that expired by now; returns how many went."""
+        released = []
+
+        def delete(conn: sqlite3.Connection) -> int:
+            rows = conn.execute(SQL_EXPIRED_MESSAGES, (now, limit)).fetchall()
+            for message_id, blob_hash in rows:
+                conn.execute(SQL_DELETE_MESSAGE, (message_id,))
+                if blob_hash:
+                    self._release_blob(shard, conn, blob_hash, released)
+            return len(rows)
+
+        count = shard.group_commit.submit(delete)
+        self._remove_blobs(shard, released)
+        return count
+
+    @staticmethod
+    def _add_blob_refs(shard: StorageEngine, conn: sqlite3.Connection, blob_hash: str,
+                       content: bytes, count: int) -> None:
+        """Add count references to a blob, creating it on first use, inside the caller's write transaction."""
+        if conn.execute(SQL_ADD_BLOB_REFS, (count, blob_hash)).rowcount:
+            return
+        if shard.blobs.accepts(len(content)):
+            # the file may have been removed with the last reference since put() found it
+            shard.blobs.ensure(blob_hash, content)
+            conn.execute(SQL_INSERT_BLOB, (blob_hash, None, count, len(content)))
+        else:
+            conn.execute(SQL_INSERT_BLOB, (blob_hash, content, count, len(content)))
+
+    @staticmethod
+    def _release_blob(shard: StorageEngine, conn: sqlite3.Connection, blob_hash: str, released: list) -> None:
+        """Drop one reference to a shared blob inside the caller's write transaction.
+
+        A file whose last reference went is added to released; the caller removes it with
+        _remove_blobs once the transaction committed, so a rollback never loses a blob.
+        """
+        row = conn.execute(SQL_BLOB_REFS, (blob_hash,)).fetchone()
+        if row is None:
+            return
+        if row[0] > 1:
+            conn.execute(SQL_RELEASE_BLOB, (blob_hash,))
+            return
+        conn.execute(SQL_DELETE_BLOB, (blob_hash,))
+        if row[1]:
+            released.append((blob_hash, shard.blobs.generation(blob_hash)))
 
-    def delete_message(self, message_id: uuid.UUID) -> None:
-        with self._lock:
-            self.conn.execute("DELETE FROM messages WHERE id = ?", (str(message_id),))
-            self.conn.commit()
+    @staticmethod
+    def _remove_blobs(shard: StorageEngine, released: list) -> None:
+        for blob_hash, generation in released:
+            shard.blobs.remove(blob_hash, generation)
 
     # ---------- Utilities ----------
     def clear_all(self) -> None:
-        with self._lock:
-            self.conn.execute("DELETE FROM clients")
-            self.conn.execute("DELETE FROM messages")
-            self.conn.commit()
+        with self.engine.writer() as conn:
+            conn.execute("DELETE FROM clients")
+        self.engine.directory.clear()
+        for shard in self.engine.shards:
+            with shard.writer() as conn:
+                conn.execute("DELETE FROM messages")
+                conn.execute("DELETE FROM message_blobs")
+            shard.blobs.clear()
 
     def close(self):
-        with self._lock:
-            try:
-                self.conn.commit()
-                self.conn.close()
-            except Exception:
-                pass
+        """The engine outlives managers; it is closed once at shutdown."""
+        pass
@@ -0,0 +1,250 @@
+import sqlite3
+import threading
+import queue
+import os
+import uuid
+import time
+import zlib
+from contextlib import contextmanager
+from typing import Dict
+from protocol.enums import MessageType, MessageFlag
+from storage.group_commit import GroupCommitWriter
+from storage.client_directory import ClientDirectory
+from storage.blob_store import BlobStore
+from utils.logger import ServerLogger
+
+
+class StorageEngine:
+    """Process-wide SQLite access: one writer connection and a bounded pool of readers.
+
+    The database runs in WAL mode so readers never wait for the writer. Every connection
+    keeps its own prepared statement cache, so the SQL text used by the managers should be
+    module-level constants to be reused across calls.
+
+    With more than one shard, mailboxes live in separate message shards, each an engine of
+    its own with its own file, writer, group commit thread and blob store, chosen by a hash
+    of the recipient id. The main database keeps the clients table and the directory.
+    """
+
+    DEFAULT_MAX_READERS = 8
+    STATEMENT_CACHE_SIZE = 256
+    # seconds an undelivered message is kept, by type; 0 keeps it until pulled, and expiry is
+    # opt-in so an upgrade never starts deleting mail the operator expected to be kept
+    DEFAULT_MESSAGE_TTL = {
+        MessageType.REQUEST_SYM_KEY: 0,
+        MessageType.SEND_SYM_KEY: 0,
+        MessageType.TEXT_MESSAGE: 0,
+        MessageType.FILE_MESSAGE: 0,
+    }
+    SQL_GET_META = "SELECT value FROM storage_meta WHERE key = ?"
+    SQL_SET_META = "INSERT OR REPLACE INTO storage_meta (key, value) VALUES (?, ?)"
+
+    _instances = {}
+    _instances_lock = threading.Lock()
+
+    @classmethod
+    def instance(cls, db_path: str = "defensive.db", shards: int = 1,
+                 message_ttl: Dict[int, int] = None) -> "StorageEngine":
+        """shards and message_ttl only apply when the engine for db_path is first opened."""
+        key = os.path.abspath(db_path)
+        with cls._instances_lock:
+            engine = cls._instances.get(key)
+            if engine is None:
+                engine = cls(db_path, shards=shards, message_ttl=message_ttl)
+                cls._instances[key] = engine
+            return engine
+
+    def __init__(self, db_path: str, max_readers: int = DEFAULT_MAX_READERS, shards: int = 1,
+                 shard_index: int = None, message_ttl: Dict[int, int] = None):
+        self.db_path = db_path
+        self.shard_index = shard_index
+        self.message_ttl = dict(self.DEFAULT_MESSAGE_TTL)
+        self.message_ttl.update(message_ttl or {})
+        if os.path.dirname(self.db_path):
+            os.makedirs(os.path.dirname(self.db_path), exist_ok=True)
+
+        self._writer = self._connect()
+        self._enable_incremental_vacuum()
+        self._writer.execute("PRAGMA journal_mode = WAL;")
+        self._writer_lock = threading.Lock()
+
+        # readers are opened on demand; the semaphore bounds how many exist at once
+        self._readers = queue.LifoQueue()
+        self._reader_slots = threading.BoundedSemaphore(max_readers)
+        self._closed = False
+
+        self._ensure_schema()
+        blob_dir = "blobs" if shard_index is None else f"blobs.shard{shard_index}"
+        self.blobs = BlobStore(os.path.join(os.path.dirname(os.path.abspath(db_path)), blob_dir))
+        self.group_commit = GroupCommitWriter(self)
+        if shard_index is not None:
+            # a message shard holds mailboxes only
+            self.directory = None
+            self.shards = [self]
+            return
+
+        self.directory = ClientDirectory(self)
+        self._check_shard_count(shards)
+        if shards == 1:
+            self.shards = [self]
+        else:
+            base, ext = os.path.splitext(db_path)
+            self.shards = [StorageEngine(f"{base}.shard{i}{ext}", max_readers, shard_index=i, message_ttl=message_ttl)
+                           for i in range(shards)]
+
+    def _check_shard_count(self, shards: int) -> None:
+        """Mailboxes are placed by shard count, so it cannot change while messages are stored."""
+        if shards < 1:
+            raise ValueError("Shard count must be at least 1")
+        with self.writer() as conn:
+            row = conn.execute(self.SQL_GET_META, ("message_shards",)).fetchone()
+            stored = int(row[0]) if row else 1
+            if stored != shards and (row or conn.execute("SELECT 1 FROM messages LIMIT 1").fetchone()):
+                raise ValueError(f"{self.db_path} was created with {stored} message shard(s), not {shards}")
+            conn.execute(self.SQL_SET_META, ("message_shards", str(shards)))
+
+    def expires_at(self, msg_type: int):
+        """Expiry time (unix seconds) for a message stored now, or None when its type never expires."""
+        ttl = self.message_ttl.get(MessageFlag.base_type(msg_type), 0)
+        return int(time.time()) + ttl if ttl else None
+
+    def shard_for(self, client_id: uuid.UUID) -> "StorageEngine":
+        """The engine holding client_id's mailbox."""
+        if len(self.shards) == 1:
+            return self.shards[0]
+        return self.shards[zlib.crc32(client_id.bytes) % len(self.shards)]
+
+    def _connect(self) -> sqlite3.Connection:
+        conn = sqlite3.connect(self.db_path, check_same_thread=False, cached_statements=self.STATEMENT_CACHE_SIZE)
+        conn.execute("PRAGMA foreign_keys = ON;")
+        return conn
+
+    # ---------- Schema ----------
+    def _enable_incremental_vacuum(self) -> None:
+        """Let the sweeper hand freed pages back to the file system a few at a time."""
+        if self._writer.execute("PRAGMA auto_vacuum").fetchone()[0] == 2:
+            return
+        # a new file takes the mode at once; an existing one needs a full VACUUM, which can take
+        # minutes on a large mailbox, so that is left to convert_to_incremental_vacuum()
+        self._writer.execute("PRAGMA auto_vacuum = INCREMENTAL")
+        if self._writer.execute("SELECT 1 FROM sqlite_master LIMIT 1").fetchone():
+            ServerLogger().warning(f"{self.db_path} does not use incremental vacuum; freed pages stay in the file "
+                                   f"until it is converted with main.py --vacuum")
+
+    def convert_to_incremental_vacuum(self) -> None:
+        """One-time maintenance: rewrite this database and its shards so the sweeper can shrink them."""
+        logger = ServerLogger()
+        for engine in dict.fromkeys([self] + self.shards):
+            with engine._writer_lock:
+                if engine._writer.execute("PRAGMA auto_vacuum").fetchone()[0] == 2:
+                    logger.info(f"{engine.db_path} already uses incremental vacuum")
+                    continue
+                logger.info(f"Converting {engine.db_path} to incremental vacuum with a full VACUUM...")
+                started = time.monotonic()
+                engine._writer.execute("PRAGMA auto_vacuum = INCREMENTAL")
+                engine._writer.execute("VACUUM")
+                logger.info(f"Converted {engine.db_path} in {time.monotonic() - started:.1f}s")
+
+    def _ensure_schema(self) -> None:
+        """Create tables and indexes once per process."""
+        with self.writer() as conn:
+            conn.execute("""
+                CREATE TABLE IF NOT EXISTS storage_meta (
+                    key TEXT PRIMARY KEY,
+                    value TEXT
+                )
+            """)
+            conn.execute("""
+                CREATE TABLE IF NOT EXISTS clients (
+                    id TEXT PRIMARY KEY,
+                    username BLOB UNIQUE,
+                    public_key BLOB,
+                    last_seen TEXT
+                )
+            """)
+            conn.execute("""
+                CREATE TABLE IF NOT EXISTS messages (
+                    id TEXT PRIMARY KEY,
+                    to_client TEXT,
+                    from_client TEXT,
+                    msg_type INTEGER,
+                    content BLOB,
+                    blob_hash TEXT,
+                    expires_at INTEGER
+                )
+            """)
+            # content shared by several mailbox rows is stored once, keyed by its SHA-256;
+            # large content is kept in the BlobStore and has a NULL content here
+            conn.execute("""
+                CREATE TABLE IF NOT EXISTS message_blobs (
+                    hash TEXT PRIMARY KEY,
+                    content BLOB,
+                    ref_count INTEGER,
+                    size INTEGER
+                )
+            """)
+            columns = [row[1] for row in conn.execute("PRAGMA table_info(messages)").fetchall()]
+            if "blob_hash" not in columns:
+                conn.execute("ALTER TABLE messages ADD COLUMN blob_hash TEXT")
+            if "expires_at" not in columns:
+                conn.execute("ALTER TABLE messages ADD COLUMN expires_at INTEGER")
+                # messages stored before expiry existed get their full TTL from now
+                for msg_type in MessageType:
+                    conn.execute("UPDATE messages SET expires_at = ? WHERE msg_type IN (?, ?)",
+                                 (self.expires_at(msg_type), int(msg_type), int(msg_type | MessageFlag.COMPRESSED)))
+            columns = [row[1] for row in conn.execute("PRAGMA table_info(message_blobs)").fetchall()]
+            if "size" not in columns:
+                conn.execute("ALTER TABLE message_blobs ADD COLUMN size INTEGER")
+            # pulls select a whole mailbox
+            conn.execute("CREATE INDEX IF NOT EXISTS idx_messages_to_client ON messages (to_client)")
+            # the sweeper selects expired rows
+            conn.execute("CREATE INDEX IF NOT EXISTS idx_messages_expires_at ON messages (expires_at) "
+                         "WHERE expires_at IS NOT NULL")
+
+    # ---------- Connections ----------
+    @contextmanager
+    def reader(self):
+        """Borrow a read connection; blocks while all readers are in use."""
+        self._reader_slots.acquire()
+        try:
+            try:
+                conn = self._readers.get_nowait()
+            except queue.Empty:
+                conn = self._connect()
+            try:
+                yield conn
+            finally:
+                self._readers.put(conn)
+        finally:
+            self._reader_slots.release()
+
+    @contextmanager
+    def writer(self):
+        """Run one transaction on the single writer connection; commits on success."""
+        with self._writer_lock:
+            try:
+                yield self._writer
+                self._writer.commit()
+            except Exception:
+                self._writer.rollback()
+                raise
+
+    def close(self) -> None:
+        for shard in self.shards:
+            if shard is not self:
+                shard.close()
+        self.group_commit.close()
+        with self._writer_lock:
+            if self._closed:
+                return
+            self._closed = True
+            try:
+                self._writer.commit()
+                self._writer.close()
+            except Exception:
+                pass
+        while True:
+            try:
+                self._readers.get_nowait().close()
+            except queue.Empty:
+                break
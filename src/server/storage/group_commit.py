@@ -0,0 +1,98 @@
+import queue
+import threading
+import time
+from concurrent.futures import Future
+from typing import Any, Callable
+
+
+class GroupCommitWriter:
+    """Runs small write operations from many handler threads in shared transactions.
+
+    submit() blocks until the transaction holding the operation has committed, so a write is
+    durable once it is acknowledged. A single commit (and a single fsync) covers every operation
+    that arrived while the previous batch was being written. Each operation runs in its own
+    savepoint, so a failing insert is rolled back alone and the rest of the batch still commits.
+    """
+
+    DEFAULT_MAX_BATCH = 256
+    DEFAULT_MAX_DELAY = 0.002  # seconds to wait for more writers once a burst is detected
+
+    def __init__(self, engine, max_batch: int = DEFAULT_MAX_BATCH, max_delay: float = DEFAULT_MAX_DELAY):
+        self._engine = engine
+        self._max_batch = max_batch
+        self._max_delay = max_delay
+        self._queue = queue.Queue()
+        self._last_batch_size = 0
+        self._thread = threading.Thread(target=self._run, name="GroupCommit", daemon=True)
+        self._thread.start()
+
+    def submit(self, operation: Callable[[Any], Any]) -> Any:
+        """Run operation(conn) in the next group transaction and return its result once durable."""
+        future = Future()
+        self._queue.put((operation, future))
+        return future.result()
+
+    def close(self) -> None:
+        self._queue.put(None)
+        self._thread.join()
+
+    def _run(self) -> None:
+        while True:
+            item = self._queue.get()
+            if item is None:
+                return
+            batch = [item]
+            stopping = self._collect(batch)
+            self._commit(batch)
+            if stopping:
+                return
+
+    def _collect(self, batch: list) -> bool:
+        """Take what is already queued; wait briefly for more only while writers are bursting."""
+        # a lone writer is committed at once; the batching window opens only after a commit
+        # that already carried several writers, so single-client latency is unchanged
+        wait = self._max_delay if self._last_batch_size > 1 else 0
+        deadline = time.monotonic() + wait
+        while len(batch) < self._max_batch:
+            try:
+                item = self._queue.get_nowait()
+            except queue.Empty:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                try:
+                    item = self._queue.get(timeout=remaining)
+                except queue.Empty:
+                    break
+            if item is None:
+                return True
+            batch.append(item)
+        return False
+
+    def _commit(self, batch: list) -> None:
+        outcomes = []
+        try:
+            with self._engine.writer() as conn:
+                conn.execute("BEGIN")
+                for operation, future in batch:
+                    conn.execute("SAVEPOINT grouped_write")
+                    try:
+                        outcomes.append((future, operation(conn), None))
+                        conn.execute("RELEASE grouped_write")
+                    except Exception as e:
+                        conn.execute("ROLLBACK TO grouped_write")
+                        conn.execute("RELEASE grouped_write")
+                        outcomes.append((future, None, e))
+        except Exception as e:
+            for _, future in batch:
+                future.set_exception(e)
+            return
+        finally:
+            self._last_batch_size = len(batch)
+
+        # results are released only after the commit returned
+        for future, result, error in outcomes:
+            if error is not None:
+                future.set_exception(error)
+            else:
+                future.set_result(result)
@@ -0,0 +1,65 @@
+import threading
+import time
+from storage.db_manager import DatabaseManager
+from utils.logger import ServerLogger
+
+
+class ExpirySweeper:
+    """Background thread that deletes expired messages and compacts the mailbox databases.
+
+    Each pass deletes the expired rows of every shard in batches, each batch a single group
+    commit, so normal writes interleave with the sweep. Pages freed by deletes are then handed
+    back to the file system with incremental vacuum, a bounded number per pass, so the files
+    shrink without a full VACUUM ever holding the writer.
+    """
+
+    DEFAULT_INTERVAL = 60.0
+    BATCH_SIZE = 500
+    VACUUM_MIN_FREE_PAGES = 256  # smaller free lists are left for new rows to reuse
+    VACUUM_MAX_PAGES = 2048
+
+    def __init__(self, engine, interval: float = DEFAULT_INTERVAL):
+        self._engine = engine
+        self._db = DatabaseManager(engine.db_path)
+        self._interval = interval
+        self._stop = threading.Event()
+        self.logger = ServerLogger()
+        self._thread = threading.Thread(target=self._run, name="ExpirySweeper", daemon=True)
+
+    def start(self) -> None:
+        self._thread.start()
+
+    def close(self) -> None:
+        self._stop.set()
+        if self._thread.is_alive():
+            self._thread.join()
+
+    def _run(self) -> None:
+        while not self._stop.wait(self._interval):
+            try:
+                self.sweep()
+            except Exception:
+                self.logger.exception("Expiry sweep failed")
+
+    def sweep(self) -> int:
+        """One pass over every shard; returns the number of messages deleted."""
+        now = int(time.time())
+        deleted = 0
+        for shard in self._engine.shards:
+            while not self._stop.is_set():
+                count = self._db.delete_expired(shard, now, self.BATCH_SIZE)
+                deleted += count
+                if count < self.BATCH_SIZE:
+                    break
+            self._vacuum(shard)
+        if deleted:
+            self.logger.info(f"Expired {deleted} undelivered messages")
+        return deleted
+
+    def _vacuum(self, shard) -> None:
+        with shard.writer() as conn:
+            free_pages = conn.execute("PRAGMA freelist_count").fetchone()[0]
+            if free_pages >= self.VACUUM_MIN_FREE_PAGES:
+                # the pragma frees one page per step and execute() steps once; executescript runs it to the end
+                conn.executescript(f"PRAGMA incremental_vacuum({self.VACUUM_MAX_PAGES});")
+                self.logger.debug(f"Vacuumed {min(free_pages, self.VACUUM_MAX_PAGES)} pages of {shard.db_path}")
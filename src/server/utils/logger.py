@@ -1,11 +1,82 @@
 import logging
 import threading
+import queue
+import atexit
+import itertools
 import os
 
+
+class _BatchFlushMixin:
+    """Handler whose flush happens once per batch, from the log writer thread."""
+
+    def flush(self):
+        pass
+
+    def flush_batch(self):
+        super().flush()
+
+
+class _BatchFileHandler(_BatchFlushMixin, logging.FileHandler):
+    pass
+
+
+class _BatchStreamHandler(_BatchFlushMixin, logging.StreamHandler):
+    pass
+
+
+class _EnqueueHandler(logging.Handler):
+    """Hands the record to the writer thread; formatting and I/O happen there."""
+
+    def __init__(self, records: queue.SimpleQueue):
+        super().__init__()
+        self._records = records
+
+    def emit(self, record):
+        self._records.put(record)
+
+
+class _LogWriter(threading.Thread):
+    MAX_BATCH = 512
+
+    def __init__(self, records: queue.SimpleQueue, handlers):
+        super().__init__(name="LogWriter", daemon=True)
+        self._records = records
+        self._handlers = handlers
+
+    def run(self):
+        stopping = False
+        while not stopping:
+            record = self._records.get()
+            if record is None:
+                break
+            batch = [record]
+            while len(batch) < self.MAX_BATCH:
+                try:
+                    record = self._records.get_nowait()
+                except queue.Empty:
+                    break
+                if record is None:
+                    stopping = True
+                    break
+                batch.append(record)
+
+            for record in batch:
+                for handler in self._handlers:
+                    if record.levelno >= handler.level:
+                        handler.handle(record)
+            for handler in self._handlers:
+                handler.flush_batch()
+
+
 class ServerLogger:
     _instance = None
     _lock = threading.Lock()
 
+    # set through configure() before the first ServerLogger is created
+    _async_mode = False
+    _level = logging.DEBUG
+    _request_sample = 1
+
     def __new__(cls, log_file="server.log"):
         with cls._lock:
             if cls._instance is None:
@@ -13,27 +84,57 @@ class ServerLogger:
                 cls._instance._initialize(log_file)
         return cls._instance
 
+    @classmethod
+    def configure(cls, async_mode: bool = False, level: str = "DEBUG", request_sample: int = 1):
+        """async_mode moves formatting and I/O to a writer thread; request_sample keeps the lines of 1 in N requests."""
+        cls._async_mode = async_mode
+        cls._level = logging.getLevelName(level.upper())
+        cls._request_sample = max(1, request_sample)
+
     def _initialize(self, log_file):
         self.log_file = log_file
         dir_name = os.path.dirname(log_file)
         if dir_name:
             os.makedirs(dir_name, exist_ok=True)
 
+        self._writer = None
+        self._request_counter = itertools.count()
         self.logger = logging.getLogger("MessageUServer")
         if not self.logger.handlers:
-            self.logger.setLevel(logging.DEBUG)
+            self.logger.setLevel(self._level)
             fmt = logging.Formatter("%(asctime)s [%(levelname)s] [%(threadName)s] %(message)s")
 
-            file_handler = logging.FileHandler(log_file, mode="a", encoding="utf-8", delay=False)
-            stream_handler = logging.StreamHandler()
+            if self._async_mode:
+                file_handler = _BatchFileHandler(log_file, mode="a", encoding="utf-8", delay=False)
+                stream_handler = _BatchStreamHandler()
+            else:
+                file_handler = logging.FileHandler(log_file, mode="a", encoding="utf-8", delay=False)
+                stream_handler = logging.StreamHandler()
 
             file_handler.setFormatter(fmt)
             stream_handler.setFormatter(fmt)
 
-            self.logger.addHandler(file_handler)
-            self.logger.addHandler(stream_handler)
+            if self._async_mode:
+                records = queue.SimpleQueue()
+                self._records = records
+                self._writer = _LogWriter(records, [file_handler, stream_handler])
+                self._writer.start()
+                self.logger.addHandler(_EnqueueHandler(records))
+                atexit.register(self.stop)
+            else:
+                self.logger.addHandler(file_handler)
+                self.logger.addHandler(stream_handler)
+
+    def stop(self):
+        """Drain the queue and stop the writer thread (async mode)."""
+        if self._writer and self._writer.is_alive():
+            self._records.put(None)
+            self._writer.join()
 
     def _flush(self):
+        # in async mode the writer thread flushes once per batch
+        if self._writer:
+            return
         for h in self.logger.handlers:
             h.flush()
 
@@ -57,6 +158,10 @@ class ServerLogger:
         self.logger.exception(message)
         self._flush()
 
+    def sample_request(self) -> bool:
+        """Whether this request's per-request lines are logged (1 in request_sample requests)."""
+        return self._request_sample == 1 or next(self._request_counter) % self._request_sample == 0
+
     def separator(self):
         self.logger.info("=" * 80)
         self._flush()